@@ -0,0 +1,396 @@
+// Benchmark for the image recognition part over the bundled board images.
+// Times every stage headlessly, counts the allocations in it and checks the
+// boards against known answers.
+//
+// Usage: ip_bench [-n iterations] [--per-square | --pyramid] [--engine hough|line2d|rotated|contour] [--localize]
+//                 [--denoise bilateral|separable|guided|downsampled] [--no-prefilter] [--min-accuracy 0.0-1.0]
+
+#include <opencv2/opencv.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "ip_process.hpp"
+#include "boardLocator.hpp"
+#include "imageLoader.hpp"
+
+using namespace cv;
+
+
+// Bundled images with the boards they show, rows top to bottom
+// (0 none, 1 circle, 2 A, 3 hex, 4 parallelogram, 5 star, 6 triangle)
+struct GoldenImage {
+	std::string filename;
+	int rows[Board::defaultHeight][Board::defaultWidth];
+};
+
+const GoldenImage goldenImages[] = {
+	{ "easy01.png", {
+		{ 0, 0, 0, 4, 2, 0, 0, 1 },
+		{ 0, 4, 0, 5, 0, 3, 0, 0 },
+		{ 0, 3, 0, 3, 0, 0, 5, 0 },
+		{ 0, 0, 3, 3, 0, 0, 3, 0 },
+		{ 3, 3, 0, 0, 6, 0, 0, 1 } } },
+	{ "easy02.png", {
+		{ 0, 0, 1, 0, 0, 3, 0, 0 },
+		{ 0, 4, 3, 0, 3, 3, 3, 0 },
+		{ 0, 5, 6, 3, 3, 0, 3, 0 },
+		{ 0, 1, 0, 2, 5, 0, 0, 0 },
+		{ 0, 0, 0, 4, 0, 0, 0, 0 } } },
+	{ "difficult01.png", {
+		{ 0, 0, 0, 0, 0, 0, 0, 0 },
+		{ 0, 0, 0, 0, 0, 0, 0, 0 },
+		{ 0, 0, 0, 0, 0, 0, 0, 0 },
+		{ 3, 3, 3, 3, 3, 3, 3, 3 },
+		{ 1, 4, 5, 2, 6, 5, 4, 1 } } },
+	{ "difficult02.png", {
+		{ 0, 3, 0, 0, 0, 0, 0, 0 },
+		{ 3, 4, 3, 0, 3, 3, 4, 1 },
+		{ 3, 0, 0, 6, 0, 0, 0, 0 },
+		{ 0, 0, 5, 0, 0, 2, 0, 1 },
+		{ 0, 0, 0, 3, 5, 0, 3, 0 } } }
+};
+const std::string shapeNames[] = { "circle", "A", "hex", "pogram", "star", "triangle" };
+
+
+// Allocations through operator new so far, on any thread. Also counts Mat
+// buffers, OpenCV allocates a UMatData header with new for each of them.
+std::atomic<long> allocationCount(0);
+
+void* operator new(std::size_t size) {
+	allocationCount++;
+	void* memory = std::malloc(size > 0 ? size : 1);
+	if (!memory) throw std::bad_alloc();
+	return memory;
+}
+
+void operator delete(void* memory) noexcept {
+	std::free(memory);
+}
+
+
+// Start of a stage, for its time and the allocations made during it
+struct StageStart {
+	std::chrono::steady_clock::time_point time = std::chrono::steady_clock::now();
+	long allocations = allocationCount;
+};
+
+
+// Milliseconds since start
+double elapsedMs(std::chrono::steady_clock::time_point start) {
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+
+// Timing and allocation samples per stage, in the order stages were first recorded
+class StageTimes {
+public:
+	void add(const std::string& stage, const StageStart& start) {
+		double ms = elapsedMs(start.time);
+		double allocations = allocationCount - start.allocations;
+		for (int i = 0; i < stages.size(); i++) {
+			if (stages[i] == stage) {
+				samples[i].push_back(ms);
+				allocationSamples[i].push_back(allocations);
+				return;
+			}
+		}
+		stages.push_back(stage);
+		samples.push_back(std::vector<double>(1, ms));
+		allocationSamples.push_back(std::vector<double>(1, allocations));
+	}
+
+	void print() const {
+		printf("%-22s %10s %10s %8s %8s\n", "stage", "median ms", "p99 ms", "allocs", "samples");
+		for (int i = 0; i < stages.size(); i++) {
+			printf("%-22s %10.3f %10.3f %8.0f %8i\n", stages[i].c_str(),
+				median(i), percentile(i, 0.99), medianAllocations(i), (int)samples[i].size());
+		}
+	}
+
+	// Of stage i, in the order stages were first recorded
+	double median(int i) const { return percentile(i, 0.5); }
+	double percentile(int i, double p) const { return percentile(samples[i], p); }
+	double medianAllocations(int i) const { return percentile(allocationSamples[i], 0.5); }
+
+private:
+	static double percentile(std::vector<double> sorted, double p) {
+		std::sort(sorted.begin(), sorted.end());
+		int index = std::min((int)sorted.size() - 1, (int)(p * sorted.size()));
+		return sorted[index];
+	}
+
+	std::vector<std::string> stages;
+	std::vector<std::vector<double>> samples;
+	std::vector<std::vector<double>> allocationSamples;
+};
+
+
+// Correct squares, printing the wrong ones
+int checkBoard(const Board& board, const GoldenImage& golden, bool report) {
+	int correct = 0;
+	for (int r = 0; r < Board::defaultHeight; r++) {
+		for (int c = 0; c < Board::defaultWidth; c++) {
+			int found = static_cast<int>(board.pieces(c, r));
+			if (found == golden.rows[r][c]) {
+				correct++;
+			} else if (report) {
+				printf("  %s (%i, %i): expected %i, got %i (confidence %.2f)\n", golden.filename.c_str(), c, r,
+					golden.rows[r][c], found, board.confidence(c, r));
+			}
+		}
+	}
+	return correct;
+}
+
+
+// Time every denoise filter on the same images and check the boards detected after each
+void compareDenoiseFilters(Recognizer& recognizer, const std::vector<Mat>& grayImages, int iterations) {
+	printf("\n%-22s %10s %10s %8s %8s\n", "denoise filter", "median ms", "p99 ms", "allocs", "correct");
+	int squareCount = grayImages.size() * Board::defaultWidth * Board::defaultHeight;
+	for (int f = 0; f < sizeof(denoiseFilters) / sizeof(denoiseFilters[0]); f++) {
+		StageTimes times;
+		int correct = 0;
+		Mat filtered;
+		DenoiseScratch scratch;
+		for (int n = 0; n < iterations; n++) {
+			for (int k = 0; k < grayImages.size(); k++) {
+				StageStart start;
+				denoise(grayImages[k], filtered, denoiseFilters[f], &recognizer.pool, scratch);
+				times.add("denoise", start);
+				if (n == iterations - 1) {
+					correct += checkBoard(detectPieces(filtered, recognizer), goldenImages[k], false);
+				}
+			}
+		}
+		printf("%-22s %10.3f %10.3f %8.0f %7.1f%%\n", denoiseFilterName(denoiseFilters[f]).c_str(),
+			times.median(0), times.percentile(0, 0.99), times.medianAllocations(0), 100.0 * correct / squareCount);
+	}
+}
+
+
+int main(int argc, char* argv[]) {
+	int iterations = 10;
+	double minAccuracy = 0.0;
+	HeadlessOptions options;
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg == "-n" && i + 1 < argc) {
+			iterations = std::max(1, atoi(argv[++i]));
+		} else if (arg == "--per-square") {
+			options.mode = DetectionMode::PER_SQUARE;
+		} else if (arg == "--pyramid") {
+			options.mode = DetectionMode::PYRAMID;
+		} else if (arg == "--engine" && i + 1 < argc) {
+			std::string engine = argv[++i];
+			if (engine == "hough") {
+				options.engine = DetectionEngine::HOUGH;
+			} else if (engine == "line2d") {
+				options.engine = DetectionEngine::LINE2D;
+			} else if (engine == "rotated") {
+				options.engine = DetectionEngine::ROTATED;
+			} else if (engine == "contour") {
+				options.engine = DetectionEngine::CONTOUR;
+			} else {
+				fprintf(stderr, "Unknown engine: %s\n", engine.c_str());
+				return EXIT_FAILURE;
+			}
+		} else if (arg == "--denoise" && i + 1 < argc) {
+			if (!parseDenoiseFilter(argv[++i], options.denoise)) {
+				fprintf(stderr, "Unknown denoise filter: %s\n", argv[i]);
+				return EXIT_FAILURE;
+			}
+		} else if (arg == "--localize") {
+			options.localize = true;
+		} else if (arg == "--no-prefilter") {
+			options.prefilter = false;
+		} else if (arg == "--min-accuracy" && i + 1 < argc) {
+			minAccuracy = atof(argv[++i]);
+		} else {
+			fprintf(stderr, "Unknown argument: %s\n", arg.c_str());
+			return EXIT_FAILURE;
+		}
+	}
+
+	setVisualize(false);
+	std::string imageDirectory = std::string(PROJECT_SOURCE_DIR) + "/images/";
+	StageTimes times;
+	int imageCount = sizeof(goldenImages) / sizeof(goldenImages[0]);
+	int squareCount = imageCount * Board::defaultWidth * Board::defaultHeight;
+	int stageCorrect = 0, pipelineCorrect = 0;
+	std::vector<Mat> grayImages; // Rectified, for comparing the denoise filters
+	try {
+		StageStart start;
+		TemplateBank bank = TemplateBank::load(imageDirectory + "templates/", "");
+		times.add("template load", start);
+		Recognizer recognizer(bank, options);
+		Size grid = recognizer.grid; // The golden boards are all of the default size
+
+		// Buffers of the stage by stage run, reused like the pipeline's own
+		FrameBuffers frame;
+		GradientMap gradients;
+		ResponseMaps responses;
+		Mat integralSum, integralSqSum;
+		for (int n = 0; n < iterations; n++) {
+			bool last = n == iterations - 1;
+			for (int k = 0; k < imageCount; k++) {
+				const GoldenImage& golden = goldenImages[k];
+
+				// Mapped loading for comparison, outside the stages total
+				start = StageStart();
+				readImageMapped(imageDirectory + golden.filename);
+				times.add("load mmap", start);
+
+				// Full frame stages one by one on this thread
+				StageStart total;
+				start = StageStart();
+				Mat image = readImage(imageDirectory + golden.filename);
+				times.add("load", start);
+
+				start = StageStart();
+				rectifyBoard(image, frame.rectified, grid, options.localize);
+				times.add("rectify", start);
+
+				start = StageStart();
+				cvtColor(frame.rectified, frame.gray, CV_BGR2GRAY);
+				times.add("cvtColor", start);
+
+				start = StageStart();
+				const Mat& filtered = frame.filtered;
+				denoise(frame.gray, frame.filtered, options.denoise, &recognizer.pool, frame.scratch);
+				times.add("denoise " + denoiseFilterName(options.denoise), start);
+				if (n == 0) grayImages.push_back(frame.gray.clone());
+
+				start = StageStart();
+				Occupancy occupancy = options.prefilter
+					? findOccupiedSquares(filtered, grid, recognizer.emptySquareStdDev, integralSum, integralSqSum)
+					: allSquaresOccupied(grid);
+				times.add("occupancy", start);
+
+				Board board;
+				if (recognizer.shapes) {
+					// Outlines first, the Hough detectors only see the unsure squares
+					start = StageStart();
+					Occupancy unsure = occupancy;
+					int unsureCount = 0;
+					for (int c = 0; c < grid.width; c++) {
+						for (int r = 0; r < grid.height; r++) {
+							if (!occupancy.occupied(c, r)) continue;
+							double confidence;
+							PieceShape shape = recognizer.shapes->classify(filtered(squareRect(filtered, grid, c, r)), &confidence);
+							if (confidence >= shapeMinConfidence) {
+								board.pieces(c, r) = shape;
+								unsure.occupied(c, r) = false;
+							} else {
+								unsureCount++;
+							}
+						}
+					}
+					times.add("contour classify", start);
+
+					if (unsureCount > 0) {
+						start = StageStart();
+						computeGradients(filtered, gradients);
+						for (int c = 0; c < grid.width; c++) {
+							for (int r = 0; r < grid.height; r++) {
+								if (unsure.occupied(c, r)) board.pieces(c, r) = classifySquare(gradients, grid, c, r, bank);
+							}
+						}
+						times.add("hough fallback", start);
+					}
+					times.add("stages total", total);
+				} else {
+					start = StageStart();
+					computeGradients(filtered, gradients);
+					times.add("gradients", start);
+
+					// Detection split the way detectPieces splits it for the selected mode
+					std::vector<std::vector<Vec4f>> positions(bank.size());
+					bool perSquare = recognizer.descriptors || options.mode == DetectionMode::PER_SQUARE;
+					if (recognizer.descriptors) {
+						// Rotated descriptors classify each occupied square directly
+						start = StageStart();
+						for (int c = 0; c < grid.width; c++) {
+							for (int r = 0; r < grid.height; r++) {
+								if (!occupancy.occupied(c, r)) continue;
+								board.pieces(c, r) = recognizer.descriptors->classify(gradients, squareRect(filtered, grid, c, r));
+							}
+						}
+						times.add("classify squares", start);
+					} else if (perSquare) {
+						start = StageStart();
+						for (int c = 0; c < grid.width; c++) {
+							for (int r = 0; r < grid.height; r++) {
+								if (!occupancy.occupied(c, r)) continue;
+								board.pieces(c, r) = classifySquare(gradients, grid, c, r, bank, recognizer.matcher.get());
+							}
+						}
+						times.add("classify squares", start);
+					} else if (options.mode == DetectionMode::PYRAMID) {
+						// The recognizer only allows the pyramid with the Hough engine
+						if (!recognizer.pyramid) recognizer.pyramid.reset(new PyramidDetector(bank));
+						start = StageStart();
+						positions = recognizer.pyramid->detect(filtered, gradients);
+						times.add("pyramid detect", start);
+					} else if (recognizer.matcher) {
+						start = StageStart();
+						computeResponses(gradients, responses);
+						times.add("responses", start);
+						for (int i = 0; i < bank.size(); i++) {
+							start = StageStart();
+							positions[i] = recognizer.matcher->match(responses, i);
+							times.add("match " + shapeNames[i], start);
+						}
+					} else {
+						for (int i = 0; i < bank.size(); i++) {
+							start = StageStart();
+							detectWithVotes(bank.detector(i), bank.edgePoints(i), gradients.edges, gradients.dxf, gradients.dyf, positions[i]);
+							times.add("detect " + shapeNames[i], start);
+						}
+					}
+
+					if (!perSquare) {
+						start = StageStart();
+						board = mapDetections(positions, filtered.size(), occupancy);
+						times.add("board mapping", start);
+					}
+					times.add("stages total", total);
+				}
+
+				// The whole pipeline as batch mode runs it, in the selected mode
+				start = StageStart();
+				Board pipelineBoard = processImage(image, recognizer);
+				times.add("processImage", start);
+
+				if (last) {
+					stageCorrect += checkBoard(board, golden, false);
+					pipelineCorrect += checkBoard(pipelineBoard, golden, true);
+				}
+			}
+		}
+
+		printf("\n%i iterations over %i images\n\n", iterations, imageCount);
+		times.print();
+		compareDenoiseFilters(recognizer, grayImages, iterations);
+	}
+	catch (std::exception& e) {
+		fprintf(stderr, "%s\n", e.what());
+		return EXIT_FAILURE;
+	}
+
+	double stageAccuracy = (double)stageCorrect / squareCount;
+	double pipelineAccuracy = (double)pipelineCorrect / squareCount;
+	printf("\nstage by stage:    %i of %i squares correct (%.1f%%)\n", stageCorrect, squareCount, 100 * stageAccuracy);
+	printf("processImage:      %i of %i squares correct (%.1f%%)\n", pipelineCorrect, squareCount, 100 * pipelineAccuracy);
+
+	if (pipelineAccuracy < minAccuracy) {
+		fprintf(stderr, "Accuracy %.3f is below the required %.3f\n", pipelineAccuracy, minAccuracy);
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
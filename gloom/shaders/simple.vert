@@ -2,12 +2,14 @@
 
 in layout(location=0) vec3 position;
 in layout(location=1) vec4 colour;
+in layout(location=2) mat4 instanceModel; // Locations 2-5, identity when not instanced
+in layout(location=6) vec4 instanceColour;
 out layout(location=1) vec4 colourOut;
-uniform layout(location=2) mat4 MVP;
+uniform layout(location=2) mat4 MVP; // View projection when instanced
 
 void main()
 {
-    gl_Position = MVP * vec4(position, 1.0f);
+    gl_Position = MVP * instanceModel * vec4(position, 1.0f);
 
-    colourOut = colour; // Pass on colour information
+    colourOut = colour * instanceColour; // Pass on colour information
 }
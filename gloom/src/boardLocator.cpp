@@ -0,0 +1,187 @@
+#include <algorithm>
+#include <cmath>
+
+#include "boardLocator.hpp"
+
+using namespace cv;
+
+// Lines are searched for in an image scaled down to at most this size
+const int locateMaxSide = 800;
+// Lines further than this from horizontal/vertical are not grid lines
+const double gridAngleTolerance = 20 * CV_PI / 180;
+
+
+// Grid line as position = slope * t + offset, where t is x for horizontal
+// lines and y for vertical lines
+struct GridLine {
+	double slope;
+	double offset;
+	double length; // Total length of segments merged into this line
+};
+
+
+/* Line position at t */
+double lineAt(const GridLine& line, double t) {
+	return line.slope * t + line.offset;
+}
+
+
+/* Merge segments into lines by position at the image center, weighted by length */
+std::vector<GridLine> mergeSegments(const std::vector<GridLine>& segments, double center, double tolerance) {
+	std::vector<GridLine> sorted = segments;
+	std::sort(sorted.begin(), sorted.end(), [center](const GridLine& a, const GridLine& b) {
+		return lineAt(a, center) < lineAt(b, center);
+	});
+
+	std::vector<GridLine> lines;
+	for (int i = 0; i < sorted.size(); i++) {
+		const GridLine& s = sorted[i];
+		if (!lines.empty() && lineAt(s, center) - lineAt(lines.back(), center) < tolerance) {
+			GridLine& merged = lines.back();
+			double total = merged.length + s.length;
+			merged.slope = (merged.slope * merged.length + s.slope * s.length) / total;
+			merged.offset = (merged.offset * merged.length + s.offset * s.length) / total;
+			merged.length = total;
+		} else {
+			lines.push_back(s);
+		}
+	}
+	return lines;
+}
+
+
+/*
+ * Outer board edges from grid lines: the lines must be evenly spaced and span
+ * either the whole board (squares) or only the inner lines (squares - 2).
+ */
+bool findOuterLines(std::vector<GridLine> lines, double center, double minLength, int squares,
+	GridLine& first, GridLine& last) {
+	// Piece outlines make short lines, grid lines run along the board
+	lines.erase(std::remove_if(lines.begin(), lines.end(), [minLength](const GridLine& l) {
+		return l.length < minLength;
+	}), lines.end());
+	if (lines.size() < 2) return false;
+
+	std::vector<double> gaps;
+	for (int i = 1; i < lines.size(); i++) {
+		gaps.push_back(lineAt(lines[i], center) - lineAt(lines[i - 1], center));
+	}
+	std::nth_element(gaps.begin(), gaps.begin() + gaps.size() / 2, gaps.end());
+	double spacing = gaps[gaps.size() / 2];
+	double span = lineAt(lines.back(), center) - lineAt(lines.front(), center);
+	int steps = cvRound(span / spacing);
+	if (std::abs(span - steps * spacing) > spacing / 4) return false; // Not evenly spaced
+
+	first = lines.front();
+	last = lines.back();
+	if (steps == squares) return true;
+	if (steps != squares - 2) return false;
+
+	// Only the inner lines were found, extrapolate one square outwards
+	double slopeStep = (last.slope - first.slope) / steps;
+	double offsetStep = (last.offset - first.offset) / steps;
+	first.slope -= slopeStep;
+	first.offset -= offsetStep;
+	last.slope += slopeStep;
+	last.offset += offsetStep;
+	return true;
+}
+
+
+/* Crossing of a horizontal and a vertical grid line */
+Point2f intersect(const GridLine& horizontal, const GridLine& vertical) {
+	// y = a1 x + b1, x = a2 y + b2
+	double x = (vertical.slope * horizontal.offset + vertical.offset) / (1 - vertical.slope * horizontal.slope);
+	return Point2f(x, lineAt(horizontal, x));
+}
+
+
+/* Find the board corners from its grid lines */
+bool locateBoard(const Mat& image, Size grid, Point2f corners[4]) {
+	Mat gray;
+	if (image.channels() == 1) {
+		gray = image;
+	} else {
+		cvtColor(image, gray, CV_BGR2GRAY);
+	}
+
+	// Work on a bounded size, so any camera resolution costs the same
+	double scale = std::min(1.0, (double)locateMaxSide / std::max(gray.cols, gray.rows));
+	if (scale < 1.0) {
+		resize(gray, gray, Size(), scale, scale, INTER_AREA);
+	}
+
+	Mat cannyImage;
+	Canny(gray, cannyImage, 10, 90, 3, true);
+	std::vector<Vec4i> segments;
+	HoughLinesP(cannyImage, segments, 3, 0.5*CV_PI / 180, 50, 15, 10);
+
+	std::vector<GridLine> horizontals, verticals;
+	for (int i = 0; i < segments.size(); i++) {
+		double x0 = segments[i][0], y0 = segments[i][1], x1 = segments[i][2], y1 = segments[i][3];
+		double dx = x1 - x0, dy = y1 - y0;
+		double length = std::sqrt(dx * dx + dy * dy);
+		double angle = std::atan2(std::abs(dy), std::abs(dx));
+		if (angle < gridAngleTolerance) {
+			double slope = dy / dx;
+			horizontals.push_back(GridLine{ slope, y0 - slope * x0, length });
+		} else if (angle > CV_PI / 2 - gridAngleTolerance) {
+			double slope = dx / dy;
+			verticals.push_back(GridLine{ slope, x0 - slope * y0, length });
+		}
+	}
+
+	// Merge segments closer than a fraction of a square, a grid line should run
+	// through at least a third of the board
+	double centerX = gray.cols / 2.0, centerY = gray.rows / 2.0;
+	std::vector<GridLine> rows = mergeSegments(horizontals, centerX, gray.rows / (4.0 * grid.height));
+	std::vector<GridLine> cols = mergeSegments(verticals, centerY, gray.cols / (4.0 * grid.width));
+	GridLine top, bottom, left, right;
+	if (!findOuterLines(rows, centerX, gray.cols / 3.0, grid.height, top, bottom)
+		|| !findOuterLines(cols, centerY, gray.rows / 3.0, grid.width, left, right)) {
+		return false;
+	}
+
+	corners[0] = intersect(top, left);
+	corners[1] = intersect(top, right);
+	corners[2] = intersect(bottom, right);
+	corners[3] = intersect(bottom, left);
+	for (int i = 0; i < 4; i++) {
+		corners[i] = corners[i] * (float)(1.0 / scale);
+	}
+	return true;
+}
+
+
+/* Warp the board to canonical size, or scale the whole image if no board is found */
+Mat rectifyBoard(const Mat& image, Size grid, bool localize, bool* located) {
+	Mat board;
+	rectifyBoard(image, board, grid, localize, located);
+	return board;
+}
+
+
+/* Warp or scale into board, or take image as it is */
+void rectifyBoard(const Mat& image, Mat& board, Size grid, bool localize, bool* located) {
+	Size size = canonicalBoardSize(grid);
+	Point2f corners[4];
+	bool found = localize && locateBoard(image, grid, corners);
+	if (located) *located = found;
+
+	if (board.data == image.data) {
+		board.release(); // Still a view of an earlier input, do not warp in place
+	}
+	if (found) {
+		Point2f target[4] = {
+			Point2f(0, 0),
+			Point2f(size.width, 0),
+			Point2f(size.width, size.height),
+			Point2f(0, size.height)
+		};
+		warpPerspective(image, board, getPerspectiveTransform(corners, target), size, INTER_LINEAR, BORDER_REPLICATE);
+	} else if (image.size() != size) {
+		resize(image, board, size, 0, 0, INTER_AREA);
+	} else {
+		board = image;
+	}
+}
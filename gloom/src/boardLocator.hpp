@@ -0,0 +1,32 @@
+#ifndef BOARD_LOCATOR_HPP
+#define BOARD_LOCATOR_HPP
+
+#include <opencv2/opencv.hpp>
+
+#include "ip_part.hpp"
+
+
+// Boards are warped to this many pixels per square, the scale of the templates
+const int squarePixels = 100;
+
+// Size of a rectified image of a board with grid squares across and down
+inline cv::Size canonicalBoardSize(cv::Size grid) {
+	return cv::Size(grid.width * squarePixels, grid.height * squarePixels);
+}
+
+// Find the outer corners (top left, top right, bottom right, bottom left) of a
+// board with grid squares from its lines in a BGR or gray image. Returns false
+// if no such grid was found.
+bool locateBoard(const cv::Mat& image, cv::Size grid, cv::Point2f corners[4]);
+
+// Warp the board to canonical size so later stages cost the same at any camera
+// resolution. Without localization, or if no grid is found, the whole image
+// is taken as the board and only scaled.
+cv::Mat rectifyBoard(const cv::Mat& image, cv::Size grid, bool localize, bool* located = nullptr);
+
+// Same into a reused buffer. board becomes a view of image when that already
+// has canonical size, and is never written into image's memory.
+void rectifyBoard(const cv::Mat& image, cv::Mat& board, cv::Size grid, bool localize, bool* located = nullptr);
+
+
+#endif // !BOARD_LOCATOR_HPP
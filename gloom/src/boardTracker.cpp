@@ -0,0 +1,78 @@
+#include "boardTracker.hpp"
+
+using namespace cv;
+
+// Thumbnail side length, enough to see a piece arrive or leave
+const int thumbnailSize = 8;
+
+
+BoardTracker::BoardTracker(Recognizer& recognizer, double changeThreshold)
+	: recognizer(recognizer), changeThreshold(changeThreshold), initialized(false), changed(0) {}
+
+
+/* Board for the next frame, reclassifying only squares that changed */
+Board BoardTracker::update(const Mat& image) {
+	Size grid = recognizer.grid;
+	const int squareCount = grid.area();
+	if (thumbnails.size() != squareCount) {
+		thumbnails.assign(squareCount, Mat());
+		current.assign(squareCount, Mat());
+		initialized = false;
+	}
+	SquareGrid<unsigned char> isChanged(grid.width, grid.height, 0);
+	changed = 0;
+	for (int r = 0; r < grid.height; r++) {
+		for (int c = 0; c < grid.width; c++) {
+			int i = r * grid.width + c;
+			thumbnail(image, c, r, current[i]);
+			isChanged(c, r) = !initialized
+				|| norm(current[i], thumbnails[i], NORM_L1) / (thumbnailSize * thumbnailSize) > changeThreshold;
+			if (isChanged(c, r)) changed++;
+		}
+	}
+
+	if (changed > squareCount / 2) {
+		// Camera or lighting moved, start over with a full detection
+		board = detectPieces(image, recognizer);
+		changed = squareCount;
+		thumbnails.swap(current);
+		initialized = true;
+		return board;
+	}
+
+	if (changed > 0) {
+		// Classify changed squares that are not empty, keep the rest. Only
+		// the changed squares are tested and get gradients.
+		Occupancy occupancy(grid, false);
+		for (int r = 0; r < grid.height; r++) {
+			for (int c = 0; c < grid.width; c++) {
+				if (!isChanged(c, r)) continue;
+				occupancy.occupied(c, r) = !recognizer.prefilter
+					|| squareOccupied(image, grid, c, r, recognizer.emptySquareStdDev);
+				if (!occupancy.occupied(c, r)) occupancy.pruned++;
+			}
+		}
+		Board fresh;
+		if (recognizer.shapes) {
+			fresh = classifyShapes(image, recognizer, occupancy);
+		} else {
+			computeSquareGradients(image, recognizer, occupancy);
+			fresh = classifySquares(recognizer, occupancy);
+		}
+		for (int r = 0; r < grid.height; r++) {
+			for (int c = 0; c < grid.width; c++) {
+				if (!isChanged(c, r)) continue;
+				board.pieces(c, r) = fresh.pieces(c, r);
+				board.confidence(c, r) = fresh.confidence(c, r);
+				std::swap(thumbnails[r * grid.width + c], current[r * grid.width + c]);
+			}
+		}
+	}
+	return board;
+}
+
+
+/* Downscaled inner part of square (c, r), into small's buffer */
+void BoardTracker::thumbnail(const Mat& image, int c, int r, Mat& small) const {
+	resize(image(squareInnerRect(image, recognizer.grid, c, r)), small, Size(thumbnailSize, thumbnailSize), 0, 0, INTER_AREA);
+}
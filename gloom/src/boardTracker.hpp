@@ -0,0 +1,43 @@
+#ifndef BOARD_TRACKER_HPP
+#define BOARD_TRACKER_HPP
+
+#include <opencv2/opencv.hpp>
+
+#include "ip_process.hpp"
+
+
+/*
+ * Follows one board over a sequence of frames of the same table. Keeps the
+ * last board and a small thumbnail per square, and only reclassifies the
+ * squares whose thumbnail changed. A move touches at most two squares, so a
+ * steady scene costs a couple of square classifications per frame.
+ */
+class BoardTracker {
+public:
+	// changeThreshold is the mean absolute gray level difference that marks
+	// a square as changed
+	explicit BoardTracker(Recognizer& recognizer, double changeThreshold = 10.0);
+
+	// Board for the next preprocessed frame
+	Board update(const cv::Mat& image);
+
+	// Forget the previous frame, the next update detects the whole board
+	void reset() { initialized = false; }
+
+	// Squares that were reclassified in the last update
+	int changedSquares() const { return changed; }
+
+private:
+	void thumbnail(const cv::Mat& image, int c, int r, cv::Mat& small) const;
+
+	Recognizer& recognizer;
+	double changeThreshold;
+	bool initialized;
+	int changed;
+	Board board;
+	std::vector<cv::Mat> thumbnails; // Row-major like the board
+	std::vector<cv::Mat> current;    // Of the frame being updated, swapped in when accepted
+};
+
+
+#endif // !BOARD_TRACKER_HPP
@@ -0,0 +1,59 @@
+#ifndef BOUNDED_QUEUE_HPP
+#define BOUNDED_QUEUE_HPP
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+
+/*
+ * Blocking FIFO with a fixed capacity, for handing work between pipeline
+ * threads. Producers wait while it is full, consumers wait while it is empty.
+ * close() ends the stream: pop() drains what is left and then returns false,
+ * push() returns false right away.
+ */
+template<class T>
+class BoundedQueue {
+public:
+	explicit BoundedQueue(int capacity) : capacity(capacity), closed(false) {}
+
+	BoundedQueue(const BoundedQueue&) = delete;
+	BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+	bool push(T item) {
+		std::unique_lock<std::mutex> lock(mutex);
+		notFull.wait(lock, [this]() { return closed || (int)items.size() < capacity; });
+		if (closed) return false;
+		items.push_back(std::move(item));
+		notEmpty.notify_one();
+		return true;
+	}
+
+	bool pop(T& item) {
+		std::unique_lock<std::mutex> lock(mutex);
+		notEmpty.wait(lock, [this]() { return closed || !items.empty(); });
+		if (items.empty()) return false; // Closed and drained
+		item = std::move(items.front());
+		items.pop_front();
+		notFull.notify_one();
+		return true;
+	}
+
+	void close() {
+		std::lock_guard<std::mutex> lock(mutex);
+		closed = true;
+		notFull.notify_all();
+		notEmpty.notify_all();
+	}
+
+private:
+	const int capacity;
+	bool closed;
+	std::deque<T> items;
+	std::mutex mutex;
+	std::condition_variable notFull;
+	std::condition_variable notEmpty;
+};
+
+
+#endif // !BOUNDED_QUEUE_HPP
@@ -0,0 +1,62 @@
+#ifndef BUFFER_POOL_HPP
+#define BUFFER_POOL_HPP
+
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+
+/*
+ * Fixed set of buffers handed out to the stages of a pipeline and given back
+ * after the last one. Buffers keep their memory between uses, and the pool
+ * itself never allocates after construction. acquire() waits while all
+ * buffers are out, close() makes it return nullptr instead.
+ */
+template<class T>
+class BufferPool {
+public:
+	explicit BufferPool(int count) : buffers(count), closed(false) {
+		available.reserve(count);
+		for (int i = 0; i < count; i++) {
+			available.push_back(&buffers[i]);
+		}
+	}
+
+	BufferPool(const BufferPool&) = delete;
+	BufferPool& operator=(const BufferPool&) = delete;
+
+	T* acquire() {
+		std::unique_lock<std::mutex> lock(mutex);
+		returned.wait(lock, [this]() { return closed || !available.empty(); });
+		if (closed) return nullptr;
+		T* buffer = available.back();
+		available.pop_back();
+		return buffer;
+	}
+
+	void release(T* buffer) {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			available.push_back(buffer); // Never beyond the reserved capacity
+		}
+		returned.notify_one();
+	}
+
+	void close() {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			closed = true;
+		}
+		returned.notify_all();
+	}
+
+private:
+	std::vector<T> buffers;
+	std::vector<T*> available;
+	std::mutex mutex;
+	std::condition_variable returned;
+	bool closed;
+};
+
+
+#endif // !BUFFER_POOL_HPP
@@ -0,0 +1,200 @@
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "denoise.hpp"
+
+using namespace cv;
+
+// Reference bilateral filter settings, the other filters are matched to them
+const int bilateralDiameter = 7;
+const double bilateralSigmaColor = 15.0;
+const double bilateralSigmaSpace = 15.0;
+// Guided filter window radius and regularization (gray levels squared)
+const int guidedRadius = 3;
+const double guidedEps = bilateralSigmaColor * bilateralSigmaColor;
+// Strips are not made smaller than this many rows
+const int minStripRows = 16;
+
+
+/* Command line name of a filter */
+std::string denoiseFilterName(DenoiseFilter filter) {
+	switch (filter) {
+	case DenoiseFilter::SEPARABLE:   return "separable";
+	case DenoiseFilter::GUIDED:      return "guided";
+	case DenoiseFilter::DOWNSAMPLED: return "downsampled";
+	default:                         return "bilateral";
+	}
+}
+
+
+/* Filter with a command line name, false if there is none */
+bool parseDenoiseFilter(const std::string& name, DenoiseFilter& filter) {
+	for (int i = 0; i < sizeof(denoiseFilters) / sizeof(denoiseFilters[0]); i++) {
+		if (denoiseFilterName(denoiseFilters[i]) == name) {
+			filter = denoiseFilters[i];
+			return true;
+		}
+	}
+	return false;
+}
+
+
+// Horizontal strips as the parts of a pool task
+template<class Work>
+class StripTask : public ParallelTask {
+public:
+	StripTask(int rows, int stripCount, Work& work) : rows(rows), stripCount(stripCount), work(work) {}
+
+	void run(int strip) override {
+		work(rows * strip / stripCount, rows * (strip + 1) / stripCount);
+	}
+
+private:
+	int rows, stripCount;
+	Work& work;
+};
+
+
+/* Call work(firstRow, endRow) for horizontal strips covering rows, one per pool
+   thread. Runs through parallelFor, so no task or future is allocated per frame. */
+template<class Work>
+void forEachStrip(int rows, ThreadPool* pool, Work work) {
+	int stripCount = pool ? std::max(1, std::min(pool->size(), rows / minStripRows)) : 1;
+	if (stripCount == 1) {
+		work(0, rows);
+		return;
+	}
+	StripTask<Work> task(rows, stripCount, work);
+	pool->parallelFor(task, stripCount);
+}
+
+
+/* Bilateral filter per strip. Filters read the pixels around a ROI, so strips match the whole image result. */
+void bilateralStrips(const Mat& gray, Mat& filtered, int diameter, ThreadPool* pool) {
+	filtered.create(gray.size(), CV_8UC1);
+	forEachStrip(gray.rows, pool, [&](int first, int end) {
+		Mat strip = filtered.rowRange(first, end);
+		bilateralFilter(gray.rowRange(first, end), strip, diameter, bilateralSigmaColor, bilateralSigmaSpace);
+	});
+}
+
+
+// Weights of the reference bilateral filter along one axis
+struct BilateralWeights {
+	int radius;
+	float space[bilateralDiameter];
+	float color[256]; // By absolute gray level difference
+
+	BilateralWeights() : radius(bilateralDiameter / 2) {
+		for (int k = -radius; k <= radius; k++) {
+			space[k + radius] = (float)std::exp(-k * k / (2 * bilateralSigmaSpace * bilateralSigmaSpace));
+		}
+		for (int d = 0; d < 256; d++) {
+			color[d] = (float)std::exp(-d * d / (2 * bilateralSigmaColor * bilateralSigmaColor));
+		}
+	}
+};
+const BilateralWeights bilateralWeights;
+
+
+/* One 1D bilateral pass over rows [first, end), along x or y, borders reflected */
+void bilateralPass(const Mat& src, Mat& dst, int first, int end, bool vertical) {
+	const BilateralWeights& w = bilateralWeights;
+	int cols = src.cols, rows = src.rows;
+	for (int y = first; y < end; y++) {
+		const uchar* center = src.ptr<uchar>(y);
+		uchar* out = dst.ptr<uchar>(y);
+		for (int x = 0; x < cols; x++) {
+			int value = center[x];
+			float sum = 0, weightSum = 0;
+			for (int k = -w.radius; k <= w.radius; k++) {
+				int neighbour;
+				if (vertical) {
+					int yy = std::abs(y + k);
+					yy = yy >= rows ? 2 * rows - 2 - yy : yy;
+					neighbour = src.ptr<uchar>(yy)[x];
+				} else {
+					int xx = std::abs(x + k);
+					xx = xx >= cols ? 2 * cols - 2 - xx : xx;
+					neighbour = center[xx];
+				}
+				float weight = w.space[k + w.radius] * w.color[std::abs(neighbour - value)];
+				sum += weight * neighbour;
+				weightSum += weight;
+			}
+			out[x] = saturate_cast<uchar>(sum / weightSum);
+		}
+	}
+}
+
+
+/* Separable bilateral approximation: all rows first, then all columns */
+void separableBilateral(const Mat& gray, Mat& filtered, Mat& horizontal, ThreadPool* pool) {
+	horizontal.create(gray.size(), CV_8UC1);
+	filtered.create(gray.size(), CV_8UC1);
+	forEachStrip(gray.rows, pool, [&](int first, int end) { bilateralPass(gray, horizontal, first, end, false); });
+	forEachStrip(gray.rows, pool, [&](int first, int end) { bilateralPass(horizontal, filtered, first, end, true); });
+}
+
+
+/* Self guided filter (He et al.): locally q = a * I + b with a near 1 at edges and near 0 in flat areas */
+void guidedStrip(const Mat& gray, Mat& filtered, int first, int end) {
+	// Two box filters deep, so work on a margin of two radii around the strip
+	int margin = 2 * guidedRadius;
+	int top = std::max(0, first - margin), bottom = std::min(gray.rows, end + margin);
+	Size window(2 * guidedRadius + 1, 2 * guidedRadius + 1);
+
+	Mat image, mean, meanSq, variance, a, b;
+	gray.rowRange(top, bottom).convertTo(image, CV_32F);
+	boxFilter(image, mean, CV_32F, window);
+	boxFilter(image.mul(image), meanSq, CV_32F, window);
+	variance = meanSq - mean.mul(mean);
+	a = variance / (variance + guidedEps);
+	b = mean - a.mul(mean);
+	boxFilter(a, a, CV_32F, window);
+	boxFilter(b, b, CV_32F, window);
+
+	Mat result = a.mul(image) + b;
+	Mat strip = filtered.rowRange(first, end);
+	result.rowRange(first - top, end - top).convertTo(strip, CV_8U);
+}
+
+
+void guidedFilter(const Mat& gray, Mat& filtered, ThreadPool* pool) {
+	filtered.create(gray.size(), CV_8UC1);
+	forEachStrip(gray.rows, pool, [&](int first, int end) { guidedStrip(gray, filtered, first, end); });
+}
+
+
+/* Bilateral at half size with a 5 pixel window (10 at full size), scaled back up */
+void downsampledBilateral(const Mat& gray, Mat& filtered, Mat& small, Mat& smallFiltered, ThreadPool* pool) {
+	resize(gray, small, Size(gray.cols / 2, gray.rows / 2), 0, 0, INTER_AREA);
+	bilateralStrips(small, smallFiltered, 5, pool);
+	resize(smallFiltered, filtered, gray.size(), 0, 0, INTER_LINEAR);
+}
+
+
+/* Smooth with the selected filter, the guided filter still uses its own temporaries */
+void denoise(const Mat& gray, Mat& filtered, DenoiseFilter filter, ThreadPool* pool, DenoiseScratch& scratch) {
+	switch (filter) {
+	case DenoiseFilter::SEPARABLE:
+		separableBilateral(gray, filtered, scratch.first, pool);
+		break;
+	case DenoiseFilter::GUIDED:
+		guidedFilter(gray, filtered, pool);
+		break;
+	case DenoiseFilter::DOWNSAMPLED:
+		downsampledBilateral(gray, filtered, scratch.first, scratch.second, pool);
+		break;
+	default:
+		bilateralStrips(gray, filtered, bilateralDiameter, pool);
+		break;
+	}
+}
+
+
+void denoise(const Mat& gray, Mat& filtered, DenoiseFilter filter, ThreadPool* pool) {
+	DenoiseScratch scratch;
+	denoise(gray, filtered, filter, pool, scratch);
+}
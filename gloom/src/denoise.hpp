@@ -0,0 +1,29 @@
+#ifndef DENOISE_HPP
+#define DENOISE_HPP
+
+#include <opencv2/opencv.hpp>
+#include <string>
+
+#include "ip_part.hpp"
+#include "threadPool.hpp"
+
+
+// Every filter, for listing and comparing them
+const DenoiseFilter denoiseFilters[] = {
+	DenoiseFilter::BILATERAL, DenoiseFilter::SEPARABLE, DenoiseFilter::GUIDED, DenoiseFilter::DOWNSAMPLED
+};
+
+// Intermediate images of the filters, kept by the caller between frames
+struct DenoiseScratch {
+	cv::Mat first, second;
+};
+
+// Smooth a gray image while keeping edges. Work is split into horizontal
+// strips over the pool if one is given; the result does not depend on it.
+void denoise(const cv::Mat& gray, cv::Mat& filtered, DenoiseFilter filter, ThreadPool* pool, DenoiseScratch& scratch);
+
+// Same with temporary intermediates
+void denoise(const cv::Mat& gray, cv::Mat& filtered, DenoiseFilter filter, ThreadPool* pool = nullptr);
+
+
+#endif // !DENOISE_HPP
@@ -0,0 +1,349 @@
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+#include "descriptorBank.hpp"
+#include "ip_process.hpp"
+
+using namespace cv;
+
+// Cache file header, bump version when the stored data changes
+const char descriptorCacheMagic[4] = { 'C', 'P', 'D', 'B' };
+const int descriptorCacheVersion = 2;
+
+// Orientation bins with at least this fraction of the most common bin's
+// features count as strong and index the entry
+const double strongOrientationFraction = 0.5;
+
+
+/* Smallest rotation in degrees that maps the shape onto itself */
+int symmetryPeriod(PieceShape shape) {
+	switch (shape) {
+	case PieceShape::HEX:      return 60;
+	case PieceShape::STAR:     return 72;
+	case PieceShape::TRIANGLE: return 120;
+	case PieceShape::POGRAM:   return 180;
+	default:                   return 360; // Three quarter circle and A
+	}
+}
+
+
+/* Rotate and scale the features of every template */
+void DescriptorBank::build(const TemplateBank& bank, const std::vector<double>& scales, int rotationStep) {
+	entries.clear();
+	features.clear();
+	templateSizes.clear();
+	for (int i = 0; i < bank.size(); i++) {
+		const Mat& edges = bank.templateEdges(i);
+		templateSizes.push_back(edges.size());
+		std::vector<Vec3f> base = extractEdgeFeatures(edges, orientationMaxFeatures);
+		Point2f center(edges.cols / 2.0f, edges.rows / 2.0f);
+		PieceShape shape = static_cast<PieceShape>(i + 1);
+
+		for (int s = 0; s < scales.size(); s++) {
+			for (int degrees = 0; degrees < symmetryPeriod(shape); degrees += rotationStep) {
+				// Feature positions relative to the template center, rotated and scaled
+				double angle = degrees * CV_PI / 180, cosA = std::cos(angle), sinA = std::sin(angle);
+				std::vector<Point2f> points;
+				float minX = 0, minY = 0, maxX = 0, maxY = 0; // Keep the center inside the box
+				for (int j = 0; j < base.size(); j++) {
+					float dx = base[j][0] - center.x, dy = base[j][1] - center.y;
+					Point2f p((float)(scales[s] * (cosA * dx - sinA * dy)), (float)(scales[s] * (sinA * dx + cosA * dy)));
+					minX = std::min(minX, p.x);
+					minY = std::min(minY, p.y);
+					maxX = std::max(maxX, p.x);
+					maxY = std::max(maxY, p.y);
+					points.push_back(p);
+				}
+				int left = (int)std::floor(minX), top = (int)std::floor(minY);
+				int width = (int)std::ceil(maxX) - left + 1, height = (int)std::ceil(maxY) - top + 1;
+				if (width > 255 || height > 255) {
+					throw std::runtime_error("Template too large for the descriptor bank");
+				}
+
+				Entry entry;
+				entry.shape = (unsigned char)shape;
+				entry.degrees = (unsigned short)degrees;
+				entry.scale = (float)scales[s];
+				entry.width = (unsigned char)width;
+				entry.height = (unsigned char)height;
+				entry.centerX = (unsigned char)-left;
+				entry.centerY = (unsigned char)-top;
+				entry.firstFeature = features.size();
+				entry.featureCount = points.size();
+
+				int histogram[orientationCount] = {};
+				for (int j = 0; j < points.size(); j++) {
+					OrientationFeature f;
+					f.x = (unsigned char)std::min(width - 1, cvRound(points[j].x - left));
+					f.y = (unsigned char)std::min(height - 1, cvRound(points[j].y - top));
+					f.orientation = (unsigned char)orientationBinOf(base[j][2] + degrees);
+					histogram[f.orientation]++;
+					features.push_back(f);
+				}
+				int most = *std::max_element(histogram, histogram + orientationCount);
+				entry.orientationBits = 0;
+				for (int o = 0; o < orientationCount; o++) {
+					if (most > 0 && histogram[o] >= most * strongOrientationFraction) entry.orientationBits |= 1 << o;
+				}
+				entries.push_back(entry);
+			}
+		}
+	}
+	buildIndex();
+}
+
+
+/* Entry ids per pair of strong orientation bins. Entries with a single strong
+   bin go with every pair containing it, the second bin is then just noise. */
+void DescriptorBank::buildIndex() {
+	for (int a = 0; a < orientationCount; a++) {
+		for (int b = 0; b < orientationCount; b++) {
+			index[a][b].clear();
+		}
+	}
+	for (int i = 0; i < entries.size(); i++) {
+		int bits = entries[i].orientationBits;
+		bool single = (bits & (bits - 1)) == 0;
+		for (int a = 0; a < orientationCount; a++) {
+			for (int b = a + 1; b < orientationCount; b++) {
+				bool both = (bits & (1 << a)) && (bits & (1 << b));
+				bool either = (bits & (1 << a)) || (bits & (1 << b));
+				if (both || (single && either)) index[a][b].push_back(i);
+			}
+		}
+	}
+}
+
+
+/* Cache fields are written one by one, never as whole structs whose padding
+   bytes would make the file differ between runs */
+template<typename T>
+void writeField(std::ofstream& file, const T& value) {
+	file.write((const char*)&value, sizeof(value));
+}
+
+template<typename T>
+void readField(std::ifstream& file, T& value) {
+	file.read((char*)&value, sizeof(value));
+}
+
+
+/* Write as: magic, version, template count and sizes, entry and feature counts, entries, features */
+void DescriptorBank::saveCache(const std::string& filename) const {
+	std::ofstream file(filename, std::ios::binary);
+	if (!file) {
+		throw std::runtime_error("Could not write descriptor cache: " + filename);
+	}
+	int templateCount = templateSizes.size(), entryCount = entries.size(), featureCount = features.size();
+	file.write(descriptorCacheMagic, sizeof(descriptorCacheMagic));
+	writeField(file, descriptorCacheVersion);
+	writeField(file, templateCount);
+	for (int i = 0; i < templateCount; i++) {
+		writeField(file, templateSizes[i].width);
+		writeField(file, templateSizes[i].height);
+	}
+	writeField(file, entryCount);
+	writeField(file, featureCount);
+	for (int i = 0; i < entryCount; i++) {
+		const Entry& entry = entries[i];
+		writeField(file, entry.shape);
+		writeField(file, entry.orientationBits);
+		writeField(file, entry.degrees);
+		writeField(file, entry.scale);
+		writeField(file, entry.width);
+		writeField(file, entry.height);
+		writeField(file, entry.centerX);
+		writeField(file, entry.centerY);
+		writeField(file, entry.firstFeature);
+		writeField(file, entry.featureCount);
+	}
+	for (int i = 0; i < featureCount; i++) {
+		writeField(file, features[i].x);
+		writeField(file, features[i].y);
+		writeField(file, features[i].orientation);
+	}
+}
+
+
+/* Read descriptors written by saveCache for the same templates. Anything out
+   of range means a corrupt or stale file, which is rejected so it gets rebuilt. */
+bool DescriptorBank::loadCache(const std::string& filename, const TemplateBank& bank) {
+	std::ifstream file(filename, std::ios::binary);
+	if (!file) return false;
+
+	char magic[sizeof(descriptorCacheMagic)];
+	int version = 0, templateCount = 0;
+	file.read(magic, sizeof(magic));
+	readField(file, version);
+	readField(file, templateCount);
+	if (!file || !std::equal(magic, magic + sizeof(magic), descriptorCacheMagic) || version != descriptorCacheVersion
+		|| templateCount != bank.size()) {
+		return false;
+	}
+
+	// Built from templates of other sizes means other templates
+	std::vector<Size> sizes;
+	for (int i = 0; i < templateCount; i++) {
+		int width = 0, height = 0;
+		readField(file, width);
+		readField(file, height);
+		if (!file || Size(width, height) != bank.templateEdges(i).size()) return false;
+		sizes.push_back(Size(width, height));
+	}
+
+	int entryCount = 0, featureCount = 0;
+	readField(file, entryCount);
+	readField(file, featureCount);
+	if (!file || entryCount <= 0 || featureCount <= 0 || entryCount > 1 << 20 || featureCount > 1 << 24) return false;
+	std::vector<Entry> cachedEntries(entryCount);
+	for (int i = 0; i < entryCount; i++) {
+		Entry& entry = cachedEntries[i];
+		readField(file, entry.shape);
+		readField(file, entry.orientationBits);
+		readField(file, entry.degrees);
+		readField(file, entry.scale);
+		readField(file, entry.width);
+		readField(file, entry.height);
+		readField(file, entry.centerX);
+		readField(file, entry.centerY);
+		readField(file, entry.firstFeature);
+		readField(file, entry.featureCount);
+		if (!file) return false;
+		// Shapes are template numbers counted from 1, NONE is never stored
+		if (entry.shape < 1 || entry.shape > templateCount || entry.width == 0 || entry.height == 0
+			|| entry.centerX >= entry.width || entry.centerY >= entry.height || !(entry.scale > 0)
+			|| entry.firstFeature < 0 || entry.featureCount < 0 || entry.firstFeature > featureCount - entry.featureCount) {
+			return false;
+		}
+	}
+	std::vector<OrientationFeature> cachedFeatures(featureCount);
+	for (int i = 0; i < featureCount; i++) {
+		OrientationFeature& f = cachedFeatures[i];
+		readField(file, f.x);
+		readField(file, f.y);
+		readField(file, f.orientation);
+		if (!file || f.orientation >= orientationCount) return false;
+	}
+	// Features have to stay inside their entry's box
+	for (int i = 0; i < entryCount; i++) {
+		const Entry& entry = cachedEntries[i];
+		for (int j = entry.firstFeature; j < entry.firstFeature + entry.featureCount; j++) {
+			if (cachedFeatures[j].x >= entry.width || cachedFeatures[j].y >= entry.height) return false;
+		}
+	}
+
+	templateSizes = sizes;
+	entries = cachedEntries;
+	features = cachedFeatures;
+	buildIndex();
+	return true;
+}
+
+
+/* Load from cache file if possible, else build and write the cache */
+DescriptorBank DescriptorBank::load(const TemplateBank& bank, const std::string& cacheFile) {
+	DescriptorBank descriptors;
+	if (cacheFile.empty() || !descriptors.loadCache(cacheFile, bank)) {
+		descriptors.build(bank);
+		if (!cacheFile.empty()) {
+			try {
+				descriptors.saveCache(cacheFile);
+			}
+			catch (std::runtime_error e) { // Not fatal, we just build them next time too
+				std::cerr << e.what() << std::endl;
+			}
+		}
+	}
+	return descriptors;
+}
+
+
+/* Score one entry at every position that puts its center inside target, keep the best */
+void DescriptorBank::scoreEntry(const Entry& entry, const ResponseMaps& responses, const Rect& target, Mat& scores,
+                                double& bestScore, PieceShape& best) const {
+	scoreTemplate(responses, &features[entry.firstFeature], entry.featureCount, Size(entry.width, entry.height), scores);
+	if (scores.empty() || entry.featureCount == 0) return;
+
+	double maxScore = 4.0 * entry.featureCount;
+	for (int y = 0; y < scores.rows; y++) {
+		const ushort* row = scores.ptr<ushort>(y);
+		for (int x = 0; x < scores.cols; x++) {
+			double score = row[x] / maxScore;
+			if (score >= bestScore && target.contains(Point(x * orientationSpread + entry.centerX, y * orientationSpread + entry.centerY))) {
+				bestScore = score;
+				best = static_cast<PieceShape>(entry.shape);
+			}
+		}
+	}
+}
+
+
+/* Score the entries indexed by the square's two dominant orientations, best one
+   wins. If none of them matches, the neighbouring buckets are scored. */
+PieceShape DescriptorBank::classify(const GradientMap& gradients, const Rect& square, double threshold, double* score) const {
+	if (score) *score = 0;
+	// Dominant orientations inside the square, its own border lines would
+	// outweigh the piece outline. Every pixel has at most one bit.
+	int histogram[orientationCount] = {};
+	Mat inner = gradients.orientation(insetSquare(square));
+	for (int y = 0; y < inner.rows; y++) {
+		const uchar* row = inner.ptr<uchar>(y);
+		for (int x = 0; x < inner.cols; x++) {
+			for (int o = 0; row[x] && o < orientationCount; o++) {
+				if (row[x] & (1 << o)) histogram[o]++;
+			}
+		}
+	}
+	int first = std::max_element(histogram, histogram + orientationCount) - histogram;
+	if (histogram[first] == 0) {
+		return PieceShape::NONE; // No edges at all
+	}
+	int second = first == 0 ? 1 : 0;
+	for (int o = 0; o < orientationCount; o++) {
+		if (o != first && histogram[o] > histogram[second]) second = o;
+	}
+
+	// Pad more than for upright templates, rotated pieces reach further out
+	int padX = square.width / 4, padY = square.height / 4;
+	Rect region = Rect(square.x - padX, square.y - padY, square.width + 2 * padX, square.height + 2 * padY)
+		& Rect(0, 0, gradients.edges.cols, gradients.edges.rows);
+	Rect target(square.x - region.x, square.y - region.y, square.width, square.height);
+	ResponseMaps responses;
+	computeResponses(gradients(region), responses);
+
+	PieceShape best = PieceShape::NONE;
+	double bestScore = threshold;
+	Mat scores;
+	const std::vector<int>& bucket = index[std::min(first, second)][std::max(first, second)];
+	for (int i = 0; i < bucket.size(); i++) {
+		scoreEntry(entries[bucket[i]], responses, target, scores, bestScore, best);
+	}
+
+	// Orientations can be off by a bin for noisy or small pieces, so the
+	// buckets one bin away on either axis are tried before calling the square
+	// empty. Bins wrap around, 0 and 180 degrees are the same direction.
+	if (best == PieceShape::NONE) {
+		std::vector<bool> scored(entries.size(), false);
+		for (int i = 0; i < bucket.size(); i++) {
+			scored[bucket[i]] = true;
+		}
+		for (int da = -1; da <= 1; da++) {
+			for (int db = -1; db <= 1; db++) {
+				int a = (first + da + orientationCount) % orientationCount;
+				int b = (second + db + orientationCount) % orientationCount;
+				if (a == b) continue;
+				const std::vector<int>& neighbour = index[std::min(a, b)][std::max(a, b)];
+				for (int i = 0; i < neighbour.size(); i++) {
+					if (scored[neighbour[i]]) continue;
+					scored[neighbour[i]] = true;
+					scoreEntry(entries[neighbour[i]], responses, target, scores, bestScore, best);
+				}
+			}
+		}
+	}
+	if (score && best != PieceShape::NONE) *score = bestScore;
+	return best;
+}
@@ -0,0 +1,73 @@
+#ifndef DESCRIPTOR_BANK_HPP
+#define DESCRIPTOR_BANK_HPP
+
+#include <opencv2/opencv.hpp>
+#include <string>
+#include <vector>
+
+#include "ip_part.hpp"
+#include "templateBank.hpp"
+#include "gradientMap.hpp"
+#include "orientationMatcher.hpp"
+
+
+// Default cache location, next to the template cache
+const std::string descriptorCacheFile = "descriptors.cache";
+// Rotation step of the precomputed templates in degrees
+const int descriptorRotationStep = 10;
+
+/*
+ * Orientation features of every template at every rotation (over the shape's
+ * symmetry period) and scale, computed offline and stored in one flat array.
+ * Entries are indexed by pairs of their strong orientation bins, so classifying
+ * a square first scores only the rotations that share the square's two most
+ * common orientations, found with one histogram, instead of searching all angles.
+ */
+class DescriptorBank {
+public:
+	// Rotate and scale the features of every template in the bank
+	void build(const TemplateBank& bank, const std::vector<double>& scales = std::vector<double>{ 0.9, 1.0, 1.1 },
+	           int rotationStep = descriptorRotationStep);
+
+	// Store or restore the descriptors in a binary cache file. loadCache
+	// returns false if the file is missing, invalid or made for other templates.
+	void saveCache(const std::string& filename) const;
+	bool loadCache(const std::string& filename, const TemplateBank& bank);
+
+	// Load from cache file if possible, else build and write the cache
+	static DescriptorBank load(const TemplateBank& bank, const std::string& cacheFile = descriptorCacheFile);
+
+	// Best shape for square (in gradients coordinates) whose center lies in the
+	// square, NONE if no descriptor scores above threshold. The winning score,
+	// relative to a perfect match, goes to score if given.
+	PieceShape classify(const GradientMap& gradients, const cv::Rect& square,
+	                    double threshold = orientationMatchThreshold, double* score = nullptr) const;
+
+	int size() const { return entries.size(); }
+
+private:
+	// One template at one rotation and scale
+	struct Entry {
+		unsigned char shape;            // PieceShape
+		unsigned char orientationBits;  // Strong orientation bins of the features
+		unsigned short degrees;         // Rotation
+		float scale;
+		unsigned char width, height;    // Feature bounding box
+		unsigned char centerX, centerY; // Template center inside the box
+		int firstFeature;               // Into features, followed by featureCount more
+		int featureCount;
+	};
+
+	std::vector<Entry> entries;
+	std::vector<OrientationFeature> features;
+	// Entries per pair of strong orientation bins, [lower][higher] bin
+	std::vector<int> index[orientationCount][orientationCount];
+	std::vector<cv::Size> templateSizes; // Of the bank it was built from
+
+	void buildIndex();
+	void scoreEntry(const Entry& entry, const ResponseMaps& responses, const cv::Rect& target, cv::Mat& scores,
+	                double& bestScore, PieceShape& best) const;
+};
+
+
+#endif // !DESCRIPTOR_BANK_HPP
@@ -0,0 +1,211 @@
+#include <cstdlib>
+
+#include "gradientMap.hpp"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(IP_SSE2)
+#include <emmintrin.h>
+#endif
+
+using namespace cv;
+
+// Orientation bin to bit
+const uchar orientationBits[orientationCount] = { 1, 2, 4, 8, 16, 32, 64, 128 };
+
+
+/* Quantize a gradient direction modulo 180 degrees into one of 8 bins */
+inline int orientationBin(int dx, int dy) {
+	int ax = std::abs(dx), ay = std::abs(dy);
+	// Quarter of the 0-90 degree range from tan(22.5) ~ 5/12, tan(45) = 1, tan(67.5) ~ 12/5
+	int quarter = (ay * 12 >= ax * 5) + (ay >= ax) + (ay * 5 >= ax * 12);
+	return (dx ^ dy) < 0 ? 7 - quarter : quarter; // Second quadrant mirrors the first
+}
+
+
+/* Plain gradient for one pixel, rows above/at/below and columns left/at/right */
+inline void gradientPixel(const uchar* a, const uchar* b, const uchar* c, int xl, int x, int xr, int minMagnitude,
+	short* dx, short* dy, float* dxf, float* dyf, ushort* magnitude, uchar* orientation) {
+	int gx = (a[xr] + 2 * b[xr] + c[xr]) - (a[xl] + 2 * b[xl] + c[xl]);
+	int gy = (c[xl] + 2 * c[x] + c[xr]) - (a[xl] + 2 * a[x] + a[xr]);
+	int mag = std::abs(gx) + std::abs(gy);
+	dx[x] = (short)gx;
+	dy[x] = (short)gy;
+	dxf[x] = (float)gx;
+	dyf[x] = (float)gy;
+	magnitude[x] = (ushort)mag;
+	orientation[x] = mag >= minMagnitude ? orientationBits[orientationBin(gx, gy)] : 0;
+}
+
+
+#if defined(__AVX2__)
+/* 16 pixels from x on, x - 1 and x + 16 must be inside the row */
+inline void gradientBlock(const uchar* a, const uchar* b, const uchar* c, int x, int minMagnitude,
+	short* dx, short* dy, float* dxf, float* dyf, ushort* magnitude, uchar* orientation) {
+	#define LOAD16(p) _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)(p)))
+	__m256i al = LOAD16(a + x - 1), am = LOAD16(a + x), ar = LOAD16(a + x + 1);
+	__m256i bl = LOAD16(b + x - 1), br = LOAD16(b + x + 1);
+	__m256i cl = LOAD16(c + x - 1), cm = LOAD16(c + x), cr = LOAD16(c + x + 1);
+	#undef LOAD16
+
+	__m256i gx = _mm256_sub_epi16(_mm256_add_epi16(_mm256_add_epi16(ar, cr), _mm256_slli_epi16(br, 1)),
+	                              _mm256_add_epi16(_mm256_add_epi16(al, cl), _mm256_slli_epi16(bl, 1)));
+	__m256i gy = _mm256_sub_epi16(_mm256_add_epi16(_mm256_add_epi16(cl, cr), _mm256_slli_epi16(cm, 1)),
+	                              _mm256_add_epi16(_mm256_add_epi16(al, ar), _mm256_slli_epi16(am, 1)));
+	__m256i ax = _mm256_abs_epi16(gx), ay = _mm256_abs_epi16(gy);
+	__m256i mag = _mm256_add_epi16(ax, ay);
+	_mm256_storeu_si256((__m256i*)(dx + x), gx);
+	_mm256_storeu_si256((__m256i*)(dy + x), gy);
+	_mm256_storeu_si256((__m256i*)(magnitude + x), mag);
+
+	// Widen to 32 bit for the float maps
+	_mm256_storeu_ps(dxf + x, _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm256_castsi256_si128(gx))));
+	_mm256_storeu_ps(dxf + x + 8, _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm256_extracti128_si256(gx, 1))));
+	_mm256_storeu_ps(dyf + x, _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm256_castsi256_si128(gy))));
+	_mm256_storeu_ps(dyf + x + 8, _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm256_extracti128_si256(gy, 1))));
+
+	// Bin = quarter, mirrored when dx and dy have opposite signs; 8 = no orientation
+	__m256i ay12 = _mm256_mullo_epi16(ay, _mm256_set1_epi16(12)), ay5 = _mm256_mullo_epi16(ay, _mm256_set1_epi16(5));
+	__m256i ax12 = _mm256_mullo_epi16(ax, _mm256_set1_epi16(12)), ax5 = _mm256_mullo_epi16(ax, _mm256_set1_epi16(5));
+	__m256i below1 = _mm256_cmpgt_epi16(ax5, ay12), below2 = _mm256_cmpgt_epi16(ax, ay), below3 = _mm256_cmpgt_epi16(ax12, ay5);
+	__m256i quarter = _mm256_add_epi16(_mm256_set1_epi16(3), _mm256_add_epi16(below1, _mm256_add_epi16(below2, below3)));
+	__m256i mirrored = _mm256_srai_epi16(_mm256_xor_si256(gx, gy), 15);
+	__m256i bin = _mm256_blendv_epi8(quarter, _mm256_sub_epi16(_mm256_set1_epi16(7), quarter), mirrored);
+	__m256i weak = _mm256_cmpgt_epi16(_mm256_set1_epi16((short)minMagnitude), mag);
+	bin = _mm256_blendv_epi8(bin, _mm256_set1_epi16(8), weak);
+
+	alignas(32) short bins[16];
+	_mm256_store_si256((__m256i*)bins, bin);
+	for (int i = 0; i < 16; i++) {
+		orientation[x + i] = bins[i] < 8 ? orientationBits[bins[i]] : 0;
+	}
+}
+const int gradientBlockWidth = 16;
+
+#elif defined(IP_SSE2)
+/* 8 pixels from x on, x - 1 and x + 8 must be inside the row */
+inline void gradientBlock(const uchar* a, const uchar* b, const uchar* c, int x, int minMagnitude,
+	short* dx, short* dy, float* dxf, float* dyf, ushort* magnitude, uchar* orientation) {
+	const __m128i zero = _mm_setzero_si128();
+	#define LOAD8(p) _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(p)), zero)
+	__m128i al = LOAD8(a + x - 1), am = LOAD8(a + x), ar = LOAD8(a + x + 1);
+	__m128i bl = LOAD8(b + x - 1), br = LOAD8(b + x + 1);
+	__m128i cl = LOAD8(c + x - 1), cm = LOAD8(c + x), cr = LOAD8(c + x + 1);
+	#undef LOAD8
+
+	__m128i gx = _mm_sub_epi16(_mm_add_epi16(_mm_add_epi16(ar, cr), _mm_slli_epi16(br, 1)),
+	                           _mm_add_epi16(_mm_add_epi16(al, cl), _mm_slli_epi16(bl, 1)));
+	__m128i gy = _mm_sub_epi16(_mm_add_epi16(_mm_add_epi16(cl, cr), _mm_slli_epi16(cm, 1)),
+	                           _mm_add_epi16(_mm_add_epi16(al, ar), _mm_slli_epi16(am, 1)));
+	__m128i ax = _mm_max_epi16(gx, _mm_sub_epi16(zero, gx)); // No abs before SSSE3
+	__m128i ay = _mm_max_epi16(gy, _mm_sub_epi16(zero, gy));
+	__m128i mag = _mm_add_epi16(ax, ay);
+	_mm_storeu_si128((__m128i*)(dx + x), gx);
+	_mm_storeu_si128((__m128i*)(dy + x), gy);
+	_mm_storeu_si128((__m128i*)(magnitude + x), mag);
+
+	// Sign extend to 32 bit for the float maps
+	_mm_storeu_ps(dxf + x, _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(gx, gx), 16)));
+	_mm_storeu_ps(dxf + x + 4, _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(gx, gx), 16)));
+	_mm_storeu_ps(dyf + x, _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(gy, gy), 16)));
+	_mm_storeu_ps(dyf + x + 4, _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(gy, gy), 16)));
+
+	// Bin = quarter, mirrored when dx and dy have opposite signs; 8 = no orientation
+	__m128i ay12 = _mm_mullo_epi16(ay, _mm_set1_epi16(12)), ay5 = _mm_mullo_epi16(ay, _mm_set1_epi16(5));
+	__m128i ax12 = _mm_mullo_epi16(ax, _mm_set1_epi16(12)), ax5 = _mm_mullo_epi16(ax, _mm_set1_epi16(5));
+	__m128i below1 = _mm_cmpgt_epi16(ax5, ay12), below2 = _mm_cmpgt_epi16(ax, ay), below3 = _mm_cmpgt_epi16(ax12, ay5);
+	__m128i quarter = _mm_add_epi16(_mm_set1_epi16(3), _mm_add_epi16(below1, _mm_add_epi16(below2, below3)));
+	__m128i mirrored = _mm_srai_epi16(_mm_xor_si128(gx, gy), 15);
+	__m128i bin = _mm_or_si128(_mm_andnot_si128(mirrored, quarter),
+	                           _mm_and_si128(mirrored, _mm_sub_epi16(_mm_set1_epi16(7), quarter)));
+	__m128i weak = _mm_cmpgt_epi16(_mm_set1_epi16((short)minMagnitude), mag);
+	bin = _mm_or_si128(_mm_andnot_si128(weak, bin), _mm_and_si128(weak, _mm_set1_epi16(8)));
+
+	short bins[8];
+	_mm_storeu_si128((__m128i*)bins, bin);
+	for (int i = 0; i < 8; i++) {
+		orientation[x + i] = bins[i] < 8 ? orientationBits[bins[i]] : 0;
+	}
+}
+const int gradientBlockWidth = 8;
+#endif
+
+
+/* Sobel, magnitude and orientation in one pass, borders reflected like cv::Sobel */
+void computeGradients(const Mat& gray, GradientMap& map, int cannyLow, int cannyHigh, int minMagnitude) {
+	CV_Assert(gray.type() == CV_8UC1);
+	int rows = gray.rows, cols = gray.cols;
+	map.dx.create(rows, cols, CV_16SC1);
+	map.dy.create(rows, cols, CV_16SC1);
+	map.dxf.create(rows, cols, CV_32FC1);
+	map.dyf.create(rows, cols, CV_32FC1);
+	map.magnitude.create(rows, cols, CV_16UC1);
+	map.orientation.create(rows, cols, CV_8UC1);
+
+	for (int y = 0; y < rows; y++) {
+		// Reflect 101 at the top and bottom
+		int above = y > 0 ? y - 1 : std::min(1, rows - 1);
+		int below = y < rows - 1 ? y + 1 : std::max(rows - 2, 0);
+		const uchar* a = gray.ptr<uchar>(above);
+		const uchar* b = gray.ptr<uchar>(y);
+		const uchar* c = gray.ptr<uchar>(below);
+		short* dx = map.dx.ptr<short>(y);
+		short* dy = map.dy.ptr<short>(y);
+		float* dxf = map.dxf.ptr<float>(y);
+		float* dyf = map.dyf.ptr<float>(y);
+		ushort* magnitude = map.magnitude.ptr<ushort>(y);
+		uchar* orientation = map.orientation.ptr<uchar>(y);
+
+		int x = 1;
+#if defined(__AVX2__) || defined(IP_SSE2)
+		for (; x + gradientBlockWidth < cols; x += gradientBlockWidth) {
+			gradientBlock(a, b, c, x, minMagnitude, dx, dy, dxf, dyf, magnitude, orientation);
+		}
+#endif
+		for (; x < cols - 1; x++) {
+			gradientPixel(a, b, c, x - 1, x, x + 1, minMagnitude, dx, dy, dxf, dyf, magnitude, orientation);
+		}
+
+		// Reflect 101 at the left and right
+		if (cols > 1) {
+			gradientPixel(a, b, c, 1, 0, 1, minMagnitude, dx, dy, dxf, dyf, magnitude, orientation);
+			gradientPixel(a, b, c, cols - 2, cols - 1, cols - 2, minMagnitude, dx, dy, dxf, dyf, magnitude, orientation);
+		} else {
+			gradientPixel(a, b, c, 0, 0, 0, minMagnitude, dx, dy, dxf, dyf, magnitude, orientation);
+		}
+	}
+
+	Canny(map.dx, map.dy, map.edges, cannyLow, cannyHigh, false);
+}
+
+
+/* Compute the maps of one region of the image, the views write into the full maps */
+void computeGradients(const Mat& gray, const Rect& region, GradientMap& map, int cannyLow, int cannyHigh, int minMagnitude) {
+	int rows = gray.rows, cols = gray.cols;
+	map.dx.create(rows, cols, CV_16SC1);
+	map.dy.create(rows, cols, CV_16SC1);
+	map.dxf.create(rows, cols, CV_32FC1);
+	map.dyf.create(rows, cols, CV_32FC1);
+	map.magnitude.create(rows, cols, CV_16UC1);
+	map.orientation.create(rows, cols, CV_8UC1);
+	map.edges.create(rows, cols, CV_8UC1);
+
+	Rect inside = region & Rect(0, 0, cols, rows);
+	if (inside.area() == 0) return;
+	GradientMap view = map(inside); // Same size and type, so nothing is reallocated
+	computeGradients(gray(inside), view, cannyLow, cannyHigh, minMagnitude);
+}
+
+
+/* Views of every map over the same region */
+GradientMap GradientMap::operator()(const Rect& region) const {
+	GradientMap view;
+	view.dx = dx(region);
+	view.dy = dy(region);
+	view.dxf = dxf(region);
+	view.dyf = dyf(region);
+	view.magnitude = magnitude(region);
+	view.orientation = orientation(region);
+	view.edges = edges(region);
+	return view;
+}
@@ -0,0 +1,47 @@
+#ifndef GRADIENT_MAP_HPP
+#define GRADIENT_MAP_HPP
+
+#include <opencv2/opencv.hpp>
+
+// SSE2 kernels can be used (always on x86-64)
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define IP_SSE2
+#endif
+
+// Gradients below this L1 magnitude get no orientation
+const int orientationMinMagnitude = 40;
+// Number of orientation bins over 180 degrees
+const int orientationCount = 8;
+
+/*
+ * Gradients and edges of a gray image, computed once per image and shared by
+ * every detector instead of each one running its own Canny and Sobel passes.
+ */
+struct GradientMap {
+	cv::Mat dx, dy;      // 3x3 Sobel derivatives (CV_16SC1)
+	cv::Mat dxf, dyf;    // The same as CV_32FC1, as Generalized Hough takes them
+	cv::Mat magnitude;   // |dx| + |dy| (CV_16UC1)
+	cv::Mat orientation; // Direction modulo 180 degrees in 8 bins as one bit per bin,
+	                     // 0 where magnitude is below the threshold (CV_8UC1)
+	cv::Mat edges;       // Canny edges from dx and dy (CV_8UC1)
+
+	// Views of every map over the same region
+	GradientMap operator()(const cv::Rect& region) const;
+	cv::Size size() const { return edges.size(); }
+};
+
+// Compute all maps of a gray image in one SIMD pass (AVX2 or SSE2 when the
+// compiler targets them), then Canny with the given thresholds
+void computeGradients(const cv::Mat& gray, GradientMap& map,
+                      int cannyLow = 30, int cannyHigh = 80,
+                      int minMagnitude = orientationMinMagnitude);
+
+// Compute the maps only inside region, into a map sized for the whole image.
+// The rest of the map keeps what it had, and region borders reflect like
+// image borders do, so callers pad the region beyond what they read.
+void computeGradients(const cv::Mat& gray, const cv::Rect& region, GradientMap& map,
+                      int cannyLow = 30, int cannyHigh = 80,
+                      int minMagnitude = orientationMinMagnitude);
+
+
+#endif // !GRADIENT_MAP_HPP
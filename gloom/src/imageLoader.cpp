@@ -0,0 +1,97 @@
+#include <algorithm>
+#include <fstream>
+#include <stdexcept>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "imageLoader.hpp"
+#include "ip_process.hpp"
+
+using namespace cv;
+
+
+/* Decode an image file from a memory mapping (a plain read on Windows) */
+Mat readImageMapped(const std::string& filename) {
+	Mat image;
+#ifdef _WIN32
+	std::ifstream file(filename, std::ios::binary | std::ios::ate);
+	if (file) {
+		std::vector<char> data((size_t)file.tellg());
+		file.seekg(0);
+		if (!data.empty() && file.read(data.data(), data.size())) {
+			image = imdecode(Mat(1, (int)data.size(), CV_8UC1, data.data()), IMREAD_UNCHANGED);
+		}
+	}
+#else
+	int fd = open(filename.c_str(), O_RDONLY);
+	struct stat info;
+	if (fd >= 0 && fstat(fd, &info) == 0 && info.st_size > 0) {
+		void* data = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (data != MAP_FAILED) {
+			madvise(data, info.st_size, MADV_SEQUENTIAL); // Decoders read front to back
+			try {
+				image = imdecode(Mat(1, (int)info.st_size, CV_8UC1, data), IMREAD_UNCHANGED);
+			}
+			catch (...) {
+				munmap(data, info.st_size);
+				close(fd);
+				throw;
+			}
+			munmap(data, info.st_size);
+		}
+	}
+	if (fd >= 0) close(fd);
+#endif
+	if (!image.data) {
+		throw std::runtime_error("No image data for: " + filename);
+	}
+	return image;
+}
+
+
+ImageLoader::ImageLoader(const std::vector<std::string>& files, int lookahead, bool mapped, int threadCount)
+	: files(files), lookahead(std::max(0, lookahead)), mapped(mapped), nextImage(0), nextRead(0),
+	  pool(lookahead > 0 ? std::max(1, std::min(threadCount, lookahead)) : 1) {
+	schedule();
+}
+
+
+ImageLoader::~ImageLoader() {
+	for (int i = 0; i < pending.size(); i++) {
+		pending[i].wait(); // Reads still use this loader
+	}
+}
+
+
+/* Next image in file order, from the prefetched ones if reading ahead */
+Mat ImageLoader::next() {
+	if (done()) {
+		throw std::runtime_error("No more images to load");
+	}
+	if (lookahead == 0) {
+		return load(files[nextImage++]);
+	}
+	std::future<Mat> read = std::move(pending.front());
+	pending.pop_front();
+	nextImage++;
+	schedule(); // Keep the window full while this image is recognized
+	return read.get();
+}
+
+
+Mat ImageLoader::load(const std::string& filename) const {
+	return mapped ? readImageMapped(filename) : readImage(filename);
+}
+
+
+void ImageLoader::schedule() {
+	while (lookahead > 0 && pending.size() < lookahead && nextRead < files.size()) {
+		const std::string* filename = &files[nextRead++];
+		pending.push_back(pool.submit([this, filename]() { return load(*filename); }));
+	}
+}
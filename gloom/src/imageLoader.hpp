@@ -0,0 +1,53 @@
+#ifndef IMAGE_LOADER_HPP
+#define IMAGE_LOADER_HPP
+
+#include <opencv2/opencv.hpp>
+#include <deque>
+#include <future>
+#include <string>
+#include <vector>
+
+#include "threadPool.hpp"
+
+
+// Images read and decoded ahead of the one being recognized
+const int defaultPrefetchCount = 4;
+
+// Read an image file through a memory mapping and imdecode, skipping the
+// stream copies of imread. Throws like readImage if there is no image data.
+cv::Mat readImageMapped(const std::string& filename);
+
+/*
+ * Reads and decodes a list of image files on background threads, keeping up
+ * to lookahead images in flight so the disk and PNG decoding overlap with
+ * recognition of the current image. Images come out in file order. With a
+ * lookahead of 0 every image is read on the calling thread when asked for.
+ */
+class ImageLoader {
+public:
+	ImageLoader(const std::vector<std::string>& files, int lookahead = defaultPrefetchCount,
+	            bool mapped = false, int threadCount = 2);
+
+	// Finishes the reads in flight before returning
+	~ImageLoader();
+
+	// Next image in file order, waiting for it if it is still being decoded.
+	// Rethrows the error of that image, the images after it still load.
+	cv::Mat next();
+	bool done() const { return nextImage >= files.size(); }
+
+private:
+	cv::Mat load(const std::string& filename) const;
+	void schedule(); // Start reads until lookahead are in flight
+
+	std::vector<std::string> files;
+	int lookahead;
+	bool mapped;
+	int nextImage;    // Handed out by next()
+	int nextRead;     // Scheduled on the pool
+	ThreadPool pool;
+	std::deque<std::future<cv::Mat>> pending; // Reads for nextImage onwards
+};
+
+
+#endif // !IMAGE_LOADER_HPP
@@ -0,0 +1,57 @@
+#include "instancedMesh.hpp"
+#include "program.hpp"
+
+
+/* Add an instance buffer to the mesh VAO, one model matrix and colour per instance */
+InstancedMesh createInstancedMesh(VAO_t mesh) {
+	InstancedMesh batch;
+	batch.mesh = mesh;
+	batch.capacity = 0;
+
+	glBindVertexArray(mesh.vaoID);
+	glGenBuffers(1, &batch.instanceBufferID);
+	glBindBuffer(GL_ARRAY_BUFFER, batch.instanceBufferID);
+
+	// A mat4 attribute takes four locations, one vec4 column each
+	for (int column = 0; column < 4; column++) {
+		glVertexAttribPointer(2 + column, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData),
+			(void*)(sizeof(glm::vec4) * column));
+		glVertexAttribDivisor(2 + column, 1);
+		glEnableVertexAttribArray(2 + column);
+	}
+	glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (void*)offsetof(InstanceData, colour));
+	glVertexAttribDivisor(6, 1);
+	glEnableVertexAttribArray(6);
+
+	glBindVertexArray(0);
+	return batch;
+}
+
+
+/* Upload this frame's instances and draw them all in one call */
+void drawInstances(InstancedMesh& batch) {
+	int count = batch.instances.size();
+	if (count == 0) return;
+
+	glBindBuffer(GL_ARRAY_BUFFER, batch.instanceBufferID);
+	if (count > batch.capacity) { // Only grows when instances are added
+		batch.capacity = count;
+		glBufferData(GL_ARRAY_BUFFER, sizeof(InstanceData) * count, batch.instances.data(), GL_DYNAMIC_DRAW);
+	} else {
+		glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(InstanceData) * count, batch.instances.data());
+	}
+
+	glBindVertexArray(batch.mesh.vaoID);
+	glDrawElementsInstanced(GL_TRIANGLES, batch.mesh.indexCount, batch.mesh.indexType, 0, count);
+	batch.instances.clear();
+}
+
+
+/* Identity model and a constant colour for VAOs drawn without an instance buffer */
+void setSingleInstance(glm::vec4 colour) {
+	glVertexAttrib4f(2, 1, 0, 0, 0);
+	glVertexAttrib4f(3, 0, 1, 0, 0);
+	glVertexAttrib4f(4, 0, 0, 1, 0);
+	glVertexAttrib4f(5, 0, 0, 0, 1);
+	glVertexAttrib4fv(6, &colour[0]);
+}
@@ -0,0 +1,32 @@
+#ifndef INSTANCEDMESH_HPP
+#define INSTANCEDMESH_HPP
+#pragma once
+
+#include <cstddef>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "shapes.hpp"
+
+
+// Per instance data, read by simple.vert at attribute locations 2 to 6
+typedef struct InstanceData {
+	glm::mat4 model; // Locations 2-5, one column each
+	glm::vec4 colour; // Location 6, multiplied with the vertex colour
+};
+
+// A mesh shared by many scene nodes, drawn with one instanced call per frame
+typedef struct InstancedMesh {
+	VAO_t mesh;
+	unsigned int instanceBufferID;
+	int capacity; // Instances the buffer has room for
+	std::vector<InstanceData> instances; // Gathered again each frame
+};
+
+
+InstancedMesh createInstancedMesh(VAO_t mesh);
+void drawInstances(InstancedMesh& batch);
+void setSingleInstance(glm::vec4 colour = glm::vec4(1.0f));
+
+
+#endif
@@ -0,0 +1,183 @@
+#include <opencv2/opencv.hpp>
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+#include "ip_part.hpp"
+#include "ip_process.hpp"
+#include "imageLoader.hpp"
+
+using namespace cv;
+
+
+// Totals of one archive worker
+struct ArchiveWorkerTotals {
+	int images = 0;
+	int failed = 0;
+	int pruned = 0;
+	int fallbacks = 0;
+};
+
+
+/* Milliseconds since start */
+double millisecondsSince(std::chrono::steady_clock::time_point start) {
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+
+/* String as a quoted JSON string */
+std::string jsonString(const std::string& text) {
+	std::ostringstream quoted;
+	quoted << '"';
+	for (int i = 0; i < text.size(); i++) {
+		unsigned char ch = text[i];
+		if (ch == '"' || ch == '\\') {
+			quoted << '\\' << ch;
+		} else if (ch < 0x20) {
+			quoted << "\\u" << std::hex << std::setw(4) << std::setfill('0') << (int)ch << std::dec;
+		} else {
+			quoted << ch;
+		}
+	}
+	quoted << '"';
+	return quoted.str();
+}
+
+
+/* One JSON line for a recognized board, rows top to bottom like printBoard */
+std::string boardJson(const std::string& file, const Board& board, int worker,
+                      double loadMs, double preprocessMs, double detectMs, double totalMs) {
+	std::ostringstream line;
+	line << std::fixed << std::setprecision(3);
+	line << "{\"file\": " << jsonString(file) << ", \"board\": [";
+	for (int r = 0; r < board.height(); r++) {
+		line << (r > 0 ? ", [" : "[");
+		for (int c = 0; c < board.width(); c++) {
+			line << (c > 0 ? ", " : "") << static_cast<int>(board.pieces(c, r));
+		}
+		line << "]";
+	}
+	line << "], \"confidence\": [";
+	for (int r = 0; r < board.height(); r++) {
+		line << (r > 0 ? ", [" : "[");
+		for (int c = 0; c < board.width(); c++) {
+			line << (c > 0 ? ", " : "") << board.confidence(c, r);
+		}
+		line << "]";
+	}
+	line << "], \"ms\": {\"load\": " << loadMs << ", \"preprocess\": " << preprocessMs
+		<< ", \"detect\": " << detectMs << ", \"total\": " << totalMs << "}, \"worker\": " << worker << "}";
+	return line.str();
+}
+
+
+/* Start point for archive recognition, images go to whichever worker is free next */
+int ip_archive(const std::vector<std::string>& inputs, const HeadlessOptions& options) {
+	setVisualize(false);
+	FILE* out = stdout;
+	if (!options.outputFile.empty()) {
+		out = fopen(options.outputFile.c_str(), "w");
+		if (!out) {
+			throw std::runtime_error("Could not open output file: " + options.outputFile);
+		}
+	}
+
+	std::vector<std::string> files = collectImageFiles(inputs);
+	int workerCount = options.workers > 0 ? options.workers : std::thread::hardware_concurrency();
+	workerCount = std::max(1, std::min(workerCount, (int)files.size()));
+
+	// The workers are the parallelism, OpenCV's own threads would only compete
+	// with them. The setting is process wide, so it is restored at the end.
+	int openCvThreads = getNumThreads();
+	if (workerCount > 1) setNumThreads(1);
+
+	// Own detectors and buffers per worker, each recognizer runs its parallel
+	// stages inline on a single thread. Built here so caches are written once.
+	std::vector<std::unique_ptr<Recognizer>> recognizers;
+	try {
+		TemplateBank bank = TemplateBank::load();
+		for (int w = 0; w < workerCount; w++) {
+			recognizers.push_back(std::unique_ptr<Recognizer>(new Recognizer(bank.clone(), options, 1)));
+		}
+	}
+	catch (...) {
+		setNumThreads(openCvThreads);
+		if (out != stdout) fclose(out);
+		throw;
+	}
+
+	// Images are handed out one at a time, so slow images do not hold up a
+	// whole shard while other workers sit idle
+	std::atomic<int> nextImage(0);
+	std::mutex outMutex;
+	std::vector<ArchiveWorkerTotals> totals(workerCount);
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	std::vector<std::thread> workers;
+	for (int w = 0; w < workerCount; w++) {
+		workers.push_back(std::thread([&, w]() {
+			Recognizer& recognizer = *recognizers[w];
+			ArchiveWorkerTotals& total = totals[w];
+			for (int i = nextImage++; i < files.size(); i = nextImage++) {
+				std::string line;
+				try {
+					std::chrono::steady_clock::time_point imageStart = std::chrono::steady_clock::now();
+					Mat image = options.mapImages ? readImageMapped(files[i]) : readImage(files[i]);
+					double loadMs = millisecondsSince(imageStart);
+
+					std::chrono::steady_clock::time_point stageStart = std::chrono::steady_clock::now();
+					preprocessImage(image, recognizer, recognizer.buffers);
+					double preprocessMs = millisecondsSince(stageStart);
+
+					stageStart = std::chrono::steady_clock::now();
+					Board board = detectPieces(recognizer.buffers.filtered, recognizer);
+					double detectMs = millisecondsSince(stageStart);
+
+					line = boardJson(files[i], board, w, loadMs, preprocessMs, detectMs, millisecondsSince(imageStart));
+					total.pruned += recognizer.stats.prunedSquares;
+					total.fallbacks += recognizer.stats.houghFallbacks;
+				}
+				catch (std::exception& e) { // Bad images should not stop the archive
+					line = "{\"file\": " + jsonString(files[i]) + ", \"error\": " + jsonString(e.what()) + "}";
+					total.failed++;
+				}
+				total.images++;
+
+				std::lock_guard<std::mutex> lock(outMutex);
+				fprintf(out, "%s\n", line.c_str());
+			}
+		}));
+	}
+	for (int w = 0; w < workers.size(); w++) {
+		workers[w].join();
+	}
+	setNumThreads(openCvThreads);
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	if (out != stdout) fclose(out);
+	ArchiveWorkerTotals sum;
+	for (int w = 0; w < totals.size(); w++) {
+		sum.images += totals[w].images;
+		sum.failed += totals[w].failed;
+		sum.pruned += totals[w].pruned;
+		sum.fallbacks += totals[w].fallbacks;
+	}
+	std::cerr << "Processed " << sum.images - sum.failed << " of " << files.size() << " images on "
+		<< workerCount << " workers in " << std::fixed << std::setprecision(2) << seconds << " s ("
+		<< std::setprecision(1) << (seconds > 0 ? sum.images / seconds : 0.0) << " images/s)\n";
+	for (int w = 0; w < totals.size(); w++) {
+		std::cerr << "  worker " << w << ": " << totals[w].images << " images\n";
+	}
+	if (options.prefilter) {
+		std::cerr << "Pruned " << sum.pruned << " of " << (sum.images - sum.failed) * options.boardWidth * options.boardHeight
+			<< " squares as empty\n";
+	}
+	if (options.engine == DetectionEngine::CONTOUR) {
+		std::cerr << "Contour classifier left " << sum.fallbacks << " squares to Hough\n";
+	}
+	return sum.failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
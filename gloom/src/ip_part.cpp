@@ -1,15 +1,95 @@
 
 #include <opencv2/opencv.hpp>
+#include <algorithm>
 
 #include "ip_part.hpp"
+#include "ip_process.hpp"
+#include "boardLocator.hpp"
+#include "imageLoader.hpp"
 
 using namespace cv;
 std::string windowName = "Checkers Scrutator";
 int waitTime = 0;
+// Show stages and detections in HighGUI windows (off in batch mode)
+#ifdef IP_HEADLESS
+const bool visualize = false; // HighGUI compiled out
+#else
+bool visualize = true;
+#endif
 
+// Image extensions picked up when a directory is given to batch mode
+const std::string imageExtensions[] = { ".png", ".jpg", ".jpeg", ".bmp", ".tif", ".tiff" };
 
 
-/* Read an image file or throw errof if no data */
+/* Turn HighGUI windows on or off, always off when compiled out */
+void setVisualize(bool enabled) {
+#ifndef IP_HEADLESS
+	visualize = enabled;
+#endif
+}
+
+
+/* Wait for a key press, no-op when visualization is disabled or compiled out */
+void waitForKey(int delay) {
+#ifndef IP_HEADLESS
+	if (visualize) waitKey(delay);
+#endif
+}
+
+
+/* Show an image and wait, no-op when visualization is disabled or compiled out */
+void showImage(const std::string& name, const Mat& image, int delay) {
+#ifndef IP_HEADLESS
+	if (!visualize) return;
+	namedWindow(name, WINDOW_AUTOSIZE);
+	imshow(name, image);
+	waitKey(delay);
+#endif
+}
+
+
+/* Set up templates and workers, each square task gets its own copy of the detectors */
+Recognizer::Recognizer(const TemplateBank& templates, DetectionMode mode, int threadCount)
+	: bank(templates), pool(threadCount), mode(mode) {
+	for (int i = 0; i < pool.size(); i++) {
+		workerBanks.push_back(bank.clone());
+	}
+}
+
+
+/* Set up with the detection settings of a headless run */
+Recognizer::Recognizer(const TemplateBank& templates, const HeadlessOptions& options, int threadCount)
+	: Recognizer(templates, options.mode, threadCount) {
+	prefilter = options.prefilter;
+	emptySquareStdDev = options.emptySquareStdDev;
+	localize = options.localize;
+	grid = Size(options.boardWidth, options.boardHeight);
+	if (grid.width <= 0 || grid.height <= 0) {
+		throw std::runtime_error("The board needs at least one square");
+	}
+	denoise = options.denoise;
+	engine = options.engine;
+	if (engine != DetectionEngine::HOUGH && mode == DetectionMode::PYRAMID) {
+		throw std::runtime_error("The pyramid mode only works with the Hough engine");
+	}
+	if (engine == DetectionEngine::LINE2D) {
+		matcher.reset(new OrientationMatcher(bank));
+	} else if (engine == DetectionEngine::ROTATED) {
+		descriptors.reset(new DescriptorBank(DescriptorBank::load(bank)));
+	} else if (engine == DetectionEngine::CONTOUR) {
+		// Checked at startup, a template without an outline would otherwise
+		// only show as squares that never match it
+		try {
+			shapes.reset(new ShapeClassifier(bank));
+		}
+		catch (const std::runtime_error& e) {
+			throw std::runtime_error(std::string("The contour engine cannot use these templates: ") + e.what());
+		}
+	}
+}
+
+
+/* Read an image file or throw error if no data */
 Mat readImage(std::string filename) {
 	Mat image = imread(filename, CV_LOAD_IMAGE_UNCHANGED);
 	if (!image.data) {
@@ -19,159 +99,506 @@ Mat readImage(std::string filename) {
 }
 
 
-/* Process an image */
-Board processImage(Mat image) {
-	// Create window to show images
-	namedWindow(windowName, WINDOW_AUTOSIZE);
-	imshow(windowName, image);
-	waitKey(waitTime);
+/* Print board grid (r, c) */
+void printBoard(const Board& board, FILE* out) {
+	for (int i = 0; i < board.height(); i++) {
+		for (int j = 0; j < board.width(); j++) {
+			fprintf(out, " %i", static_cast<int>(board.pieces(j, i)));
+		}
+		fprintf(out, "\n");
+	}
+}
 
-	// Preprocess image
-	cvtColor(image, image, CV_BGR2GRAY);
-	//GaussianBlur(image, image, Size(0, 0), 0.9);
-	//imshow("blurred image", image);
-	Mat filteredImage;
-	bilateralFilter(image, filteredImage, 7, 15.0, 15.0);
-	image = filteredImage;
-	imshow(windowName, image);
-	waitKey(waitTime);
-
-	// Load templates to detect (order matters)
-	std::vector<Mat> templates;
-	templates.push_back(readImage("../images/templates/34circle.png"));
-	templates.push_back(readImage("../images/templates/a.png"));
-	templates.push_back(readImage("../images/templates/hex.png"));
-	templates.push_back(readImage("../images/templates/pogram.png"));
-	templates.push_back(readImage("../images/templates/star.png"));
-	templates.push_back(readImage("../images/templates/triangle.png"));
 
-	// Board with grid of detected pieces (c, r)
-	Board board;
+/* Print the confidence of each square (r, c) */
+void printConfidence(const Board& board, FILE* out) {
+	for (int i = 0; i < board.height(); i++) {
+		for (int j = 0; j < board.width(); j++) {
+			fprintf(out, " %.2f", board.confidence(j, i));
+		}
+		fprintf(out, "\n");
+	}
+}
+
+
+/* Run every template's detector on the shared gradients, concurrently if a pool is given */
+std::vector<std::vector<Vec4f>> detectTemplates(const GradientMap& gradients, TemplateBank& bank, ThreadPool* pool) {
+	std::vector<std::vector<Vec4f>> positions(bank.size());
+	if (!pool) {
+		for (int i = 0; i < bank.size(); i++) {
+			detectWithVotes(bank.detector(i), bank.edgePoints(i), gradients.edges, gradients.dxf, gradients.dyf, positions[i]);
+		}
+		return positions;
+	}
+
+	// Each detector only reads the shared gradients and writes its own result
+	std::vector<std::future<void>> done;
+	for (int i = 0; i < bank.size(); i++) {
+		Ptr<GeneralizedHoughBallard> ghb = bank.detector(i);
+		int edgePoints = bank.edgePoints(i);
+		std::vector<Vec4f>* templPositions = &positions[i];
+		done.push_back(pool->submit([ghb, edgePoints, &gradients, templPositions]() {
+			detectWithVotes(ghb, edgePoints, gradients.edges, gradients.dxf, gradients.dyf, *templPositions);
+		}));
+	}
+	for (int i = 0; i < done.size(); i++) {
+		done[i].get(); // Rethrows detector errors
+	}
+	return positions;
+}
+
+
+/* Area of square (c, r), assuming the board fills the image */
+Rect squareRect(const Mat& image, Size grid, int c, int r) {
+	int squareWidth = image.cols / grid.width;
+	int squareHeight = image.rows / grid.height;
+	return Rect(c * squareWidth, r * squareHeight, squareWidth, squareHeight);
+}
+
+
+/* Inner part of square (c, r), leaving out the grid lines along the edges */
+Rect squareInnerRect(const Mat& image, Size grid, int c, int r) {
+	return insetSquare(squareRect(image, grid, c, r));
+}
+
+
+/* Square rect without a tenth of its size along each edge */
+Rect insetSquare(const Rect& square) {
+	int insetX = square.width / 10, insetY = square.height / 10;
+	return Rect(square.x + insetX, square.y + insetY, square.width - 2 * insetX, square.height - 2 * insetY);
+}
+
+
+/* Mark near uniform squares as empty, with temporary integral images */
+Occupancy findOccupiedSquares(const Mat& image, Size grid, double emptyStdDev) {
+	Mat sum, sqSum;
+	return findOccupiedSquares(image, grid, emptyStdDev, sum, sqSum);
+}
+
+
+/* Mark near uniform squares as empty, variance from integral images */
+Occupancy findOccupiedSquares(const Mat& image, Size grid, double emptyStdDev, Mat& sum, Mat& sqSum) {
+	integral(image, sum, sqSum, CV_64F, CV_64F);
+
+	Occupancy occupancy(grid);
+	for (int r = 0; r < grid.height; r++) {
+		for (int c = 0; c < grid.width; c++) {
+			Rect inner = squareInnerRect(image, grid, c, r);
+			int x0 = inner.x, y0 = inner.y, x1 = inner.x + inner.width, y1 = inner.y + inner.height;
+			double n = inner.area();
+			double s = sum.at<double>(y1, x1) - sum.at<double>(y0, x1) - sum.at<double>(y1, x0) + sum.at<double>(y0, x0);
+			double sq = sqSum.at<double>(y1, x1) - sqSum.at<double>(y0, x1) - sqSum.at<double>(y1, x0) + sqSum.at<double>(y0, x0);
+			double variance = sq / n - (s / n) * (s / n);
+
+			occupancy.occupied(c, r) = variance >= emptyStdDev * emptyStdDev;
+			if (!occupancy.occupied(c, r)) occupancy.pruned++;
+		}
+	}
+	return occupancy;
+}
+
+
+/* Gray level std dev test of one square, without integral images */
+bool squareOccupied(const Mat& image, Size grid, int c, int r, double emptyStdDev) {
+	Scalar mean, stdDev;
+	meanStdDev(image(squareInnerRect(image, grid, c, r)), mean, stdDev);
+	return stdDev[0] >= emptyStdDev;
+}
+
+
+/* Every square marked occupied */
+Occupancy allSquaresOccupied(Size grid) {
+	return Occupancy(grid, true);
+}
+
+
+/* Classify one square from its own region, the strongest template centered in it wins */
+PieceShape classifySquare(const GradientMap& gradients, Size grid, int c, int r, TemplateBank& bank,
+                          const OrientationMatcher* matcher, float* confidence) {
+	Rect square = squareRect(gradients.edges, grid, c, r);
+
+	// Pad the region so pieces slightly off center are still whole
+	int padX = square.width / 8, padY = square.height / 8;
+	Rect region = Rect(square.x - padX, square.y - padY, square.width + 2 * padX, square.height + 2 * padY)
+		& Rect(0, 0, gradients.edges.cols, gradients.edges.rows);
+	GradientMap roi = gradients(region);
+
+	ResponseMaps responses;
+	if (matcher) {
+		computeResponses(roi, responses);
+	}
+
+	// Strongest detection of each template with a center inside the square
+	std::vector<float> votes(bank.size(), 0.0f);
+	for (int i = 0; i < bank.size(); i++) {
+		std::vector<Vec4f> positions;
+		if (matcher) {
+			positions = matcher->match(responses, i);
+		} else {
+			detectWithVotes(bank.detector(i), bank.edgePoints(i), roi.edges, roi.dxf, roi.dyf, positions);
+		}
+		for (int j = 0; j < positions.size(); j++) {
+			Point center(region.x + (int)positions[j][0], region.y + (int)positions[j][1]);
+			if (square.contains(center)) {
+				votes[i] = std::max(votes[i], positions[j][3]);
+			}
+		}
+	}
+
+	// Earlier templates win ties, like they used to win outright
+	if (confidence) *confidence = 0;
+	int best = std::max_element(votes.begin(), votes.end()) - votes.begin();
+	if (best == votes.size() || votes[best] == 0) {
+		return PieceShape::NONE;
+	}
+	float runnerUp = 0;
+	for (int i = 0; i < votes.size(); i++) {
+		if (i != best) runnerUp = std::max(runnerUp, votes[i]);
+	}
+	if (confidence) *confidence = detectionConfidence(votes[best], runnerUp);
+	return static_cast<PieceShape>(best + 1);
+}
+
+
+/* Gradients around the occupied squares, padded past what classifySquare and
+   the descriptor bank read. Overlapping padded squares are merged first and
+   each merged region computed once, so no region border lands inside what a
+   neighbouring square reads */
+void computeSquareGradients(const Mat& image, Recognizer& recognizer, const Occupancy& occupancy) {
+	Size grid = recognizer.grid;
+	std::vector<Rect> regions;
+	for (int r = 0; r < grid.height; r++) {
+		for (int c = 0; c < grid.width; c++) {
+			if (!occupancy.occupied(c, r)) continue;
+			Rect square = squareRect(image, grid, c, r);
+			int padX = square.width / 4 + 2, padY = square.height / 4 + 2;
+			regions.push_back(Rect(square.x - padX, square.y - padY, square.width + 2 * padX, square.height + 2 * padY));
+		}
+	}
+
+	// A merged region can grow into others, so merge until nothing overlaps
+	bool merged = true;
+	while (merged) {
+		merged = false;
+		for (int i = 0; i < regions.size(); i++) {
+			for (int j = i + 1; j < regions.size(); j++) {
+				if ((regions[i] & regions[j]).area() == 0) continue;
+				regions[i] |= regions[j];
+				regions.erase(regions.begin() + j);
+				merged = true;
+				j = i;
+			}
+		}
+	}
+
+	for (int i = 0; i < regions.size(); i++) {
+		computeGradients(image, regions[i], recognizer.gradients);
+	}
+}
+
 
-	Mat currentTemplate, markedImage = image.clone();
-	cvtColor(markedImage, markedImage, CV_GRAY2BGR);
+/* Classify the occupied squares, one task per worker with its own detectors */
+Board classifySquares(Recognizer& recognizer, const Occupancy& occupancy) {
+	const GradientMap& gradients = recognizer.gradients;
+	const OrientationMatcher* matcher = recognizer.matcher.get();
+	const DescriptorBank* descriptors = recognizer.descriptors.get();
+	Size grid(occupancy.occupied.width(), occupancy.occupied.height());
+	Board board(grid.width, grid.height);
+	int squareCount = grid.area();
+	int taskCount = recognizer.workerBanks.size();
+	std::vector<std::future<void>> done;
+	for (int t = 0; t < taskCount; t++) {
+		TemplateBank* bank = &recognizer.workerBanks[t];
+		done.push_back(recognizer.pool.submit([&gradients, &board, &occupancy, grid, bank, matcher, descriptors, t, taskCount, squareCount]() {
+			for (int i = t; i < squareCount; i += taskCount) {
+				int c = i % grid.width, r = i / grid.width;
+				if (!occupancy.occupied(c, r)) continue;
+				if (descriptors) {
+					double score;
+					board.pieces(c, r) = descriptors->classify(gradients, squareRect(gradients.edges, grid, c, r), orientationMatchThreshold, &score);
+					board.confidence(c, r) = (float)score;
+				} else {
+					board.pieces(c, r) = classifySquare(gradients, grid, c, r, *bank, matcher, &board.confidence(c, r));
+				}
+			}
+		}));
+	}
+	for (int i = 0; i < done.size(); i++) {
+		done[i].get();
+	}
+	return board;
+}
+
+
+/* Confidence in the strongest detection of a square given the strongest of another template there */
+float detectionConfidence(float votes, float runnerUp) {
+	if (votes <= 0) return 0;
+	return std::min(1.0f, votes) * (1 - std::min(1.0f, runnerUp / votes));
+}
+
+
+/* Put detected template positions on the board, strongest detections first and
+   weaker ones of any template suppressed around them */
+Board mapDetections(const std::vector<std::vector<Vec4f>>& positions, Size imageSize, const Occupancy& occupancy) {
+	Board board(occupancy.occupied.width(), occupancy.occupied.height());
+	struct Candidate {
+		float votes;
+		int templ;
+		Point2f center;
+	};
+
+	// Every detection of every template, strongest first. Ties keep template
+	// order, so the earlier template still wins them.
+	std::vector<Candidate> candidates;
+	for (int i = 0; i < positions.size(); i++) {
+		for (int j = 0; j < positions[i].size(); j++) {
+			Vec4f pos = positions[i][j];
+			candidates.push_back(Candidate{ pos[3], i, Point2f(pos[0], pos[1]) });
+		}
+	}
+	std::stable_sort(candidates.begin(), candidates.end(),
+		[](const Candidate& a, const Candidate& b) { return a.votes > b.votes; });
+
+	std::vector<Point2f> kept;
+	SquareGrid<float> runnerUp(board.width(), board.height(), 0.0f); // Strongest other template per square
+	for (int k = 0; k < candidates.size(); k++) {
+		const Candidate& candidate = candidates[k];
+		// Calculate board positions
+		int r, c;
+		c = (int)candidate.center.x / (imageSize.width / board.width());
+		c = c >= board.width() ? board.width() - 1 : c; // Centers on the far edge belong to the last square
+		r = (int)candidate.center.y / (imageSize.height / board.height());
+		r = r >= board.height() ? board.height() - 1 : r;
+		if (!occupancy.occupied(c, r)) continue; // Detections on empty squares
+
+		PieceShape shape = static_cast<PieceShape>(candidate.templ + 1);
+		if (board.pieces(c, r) != PieceShape::NONE) {
+			// Square taken by a stronger detection, remember the strongest contender
+			if (board.pieces(c, r) != shape && runnerUp(c, r) == 0) runnerUp(c, r) = candidate.votes;
+			continue;
+		}
+
+		// Suppressed by a stronger detection of any template nearby (in a neighboring square)
+		bool suppressed = false;
+		for (int m = 0; m < kept.size() && !suppressed; m++) {
+			Point2f d = kept[m] - candidate.center;
+			suppressed = d.x * d.x + d.y * d.y < templateMinDist * templateMinDist;
+		}
+		if (suppressed) continue;
+
+		board.pieces(c, r) = shape;
+		board.confidence(c, r) = candidate.votes;
+		kept.push_back(candidate.center);
+	}
+
+	for (int r = 0; r < board.height(); r++) {
+		for (int c = 0; c < board.width(); c++) {
+			if (board.pieces(c, r) == PieceShape::NONE) continue;
+			board.confidence(c, r) = detectionConfidence(board.confidence(c, r), runnerUp(c, r));
+		}
+	}
+	return board;
+}
+
+
+/* Show the edge templates and mark where each template was detected */
+void showDetections(const Mat& image, const TemplateBank& bank, const std::vector<std::vector<Vec4f>>& positions) {
+	Mat markedImage, templateImage;
 	int templateWidth = 92;
-	Mat templateImage(100, templates.size() * templateWidth, CV_8UC1); // (y, x)
-	// Iterate over template list and try to detect
-	for (int i = 0; i < templates.size(); i++) {
-		// Prepare template
-		cvtColor(templates[i], currentTemplate, CV_BGR2GRAY);
-		Canny(currentTemplate, currentTemplate, 50, 100, 3, true);
+	cvtColor(image, markedImage, CV_GRAY2BGR);
+	templateImage = Mat(100, bank.size() * templateWidth, CV_8UC1); // (y, x)
+	for (int i = 0; i < bank.size(); i++) {
 		// Show cannied templates
+		const Mat& currentTemplate = bank.templateEdges(i);
 		Size templSize = currentTemplate.size();
 		currentTemplate.copyTo( Mat(templateImage, Rect(i*templateWidth, 5, templSize.width, templSize.height)) );
-		imshow("Template cannies", templateImage);
-		waitKey(1);
-
-		// Try to detect template in image and record positions
-		Ptr<GeneralizedHoughBallard> ghb = createGeneralizedHoughBallard();
-		ghb->setTemplate(currentTemplate);
-		ghb->setCannyLowThresh(30);
-		ghb->setCannyHighThresh(80);
-		ghb->setMinDist(20);
-		ghb->setVotesThreshold(75);
-		ghb->setDp(4.0);
-
-		std::vector<Vec4f> templPositions;
-		ghb->detect(image, templPositions);
-
-		// Iterate over detected positions
+		showImage("Template cannies", templateImage, 1);
+
+		// Mark detected positions
+		const std::vector<Vec4f>& templPositions = positions[i];
 		int blue = i * 25 > 255, red = 255 - i * 25; // Marker color variation for each templates
 		printf("Detect count: %i \n", templPositions.size());
 		for (int j = 0; j < templPositions.size(); j++) {
-			// Visualize detection
 			Vec4f pos = templPositions[j];
 			drawMarker( markedImage, Point(pos[0], pos[1]), Scalar(
 				blue > 255 ? 255 : blue,
 				0,
 				red < 0 ? 0 : red
 			) );
-			imshow(windowName, markedImage);
-
-			// Calculate board positions
-			int r, c;
-			c = (int)pos[0] / (image.cols / board.width);
-			c = c > board.width ? board.width : c; // May be 1 more than width, maybe (not shure if image is zero indexed)
-			r = (int)pos[1] / (image.rows / board.height);
-			r = r > board.height ? board.height : r;
-			// Check for duplicate detection
-			if (board.pieces[c][r] == PieceShape::NONE) {
-				board.pieces[c][r] = static_cast<PieceShape>(i + 1);
-			}
 		}
-		waitKey(waitTime);
+		showImage(windowName, markedImage, waitTime);
 	}
+}
 
-	printf("\nBoard:\n");
-	for (int i = 0; i < board.height; i++) {
-		for (int j = 0; j < board.width; j++) {
-			printf(" %i", board.pieces[j][i]);
+
+/* Vote for every template over the occupied part of the image, the strongest template wins a square */
+Board detectFullFrame(const Mat& image, Recognizer& recognizer, const Occupancy& occupancy) {
+	TemplateBank& bank = recognizer.bank;
+
+	// Only vote inside the bounding box of the occupied squares (padded like single squares)
+	Size grid = recognizer.grid;
+	Rect region;
+	for (int r = 0; r < grid.height; r++) {
+		for (int c = 0; c < grid.width; c++) {
+			if (!occupancy.occupied(c, r)) continue;
+			Rect square = squareRect(image, grid, c, r);
+			int padX = square.width / 8, padY = square.height / 8;
+			Rect padded(square.x - padX, square.y - padY, square.width + 2 * padX, square.height + 2 * padY);
+			region = region.area() == 0 ? padded : region | padded;
 		}
-		printf("\n");
 	}
-	printf("\n");
+	region &= Rect(0, 0, image.cols, image.rows);
+	if (region.area() == 0) {
+		return Board(grid.width, grid.height); // Nothing on the board
+	}
 
+	// Detect all templates, then merge by votes
+	std::vector<std::vector<Vec4f>> positions;
+	if (recognizer.matcher) {
+		positions = recognizer.matcher->detect(recognizer.gradients(region), &recognizer.pool);
+	} else if (recognizer.mode == DetectionMode::PYRAMID) {
+		if (!recognizer.pyramid) recognizer.pyramid.reset(new PyramidDetector(bank));
+		positions = recognizer.pyramid->detect(image(region), recognizer.gradients(region), &recognizer.pool);
+	} else {
+		positions = detectTemplates(recognizer.gradients(region), bank, &recognizer.pool);
+	}
+	for (int i = 0; i < positions.size(); i++) {
+		for (int j = 0; j < positions[i].size(); j++) {
+			positions[i][j][0] += region.x;
+			positions[i][j][1] += region.y;
+		}
+	}
+
+	Board board = mapDetections(positions, image.size(), occupancy);
+	if (visualize) {
+		showDetections(image, bank, positions);
+	}
+	return board;
+}
 
-	/////////////
-	// Test stuff
-	Mat cannyImage;
-	Canny(image, cannyImage, 10, 90, 3, true);
-	imshow("Canny & HoughLines", cannyImage);
-	waitKey(waitTime);
 
-	std::vector<Vec4i> houghLines;
-	HoughLinesP(cannyImage, houghLines, 3, 0.5*CV_PI / 180, 50, 15, 10);
-	cvtColor(cannyImage, cannyImage, CV_GRAY2BGR);
-	for (int i = 0; i < houghLines.size(); i++)
-	{
-		Vec4i linea = houghLines[i];
-		Point pt1, pt2;
-		pt1.x = linea[0];
-		pt1.y = linea[1];
-		pt2.x = linea[2];
-		pt2.y = linea[3];
-		line(cannyImage, pt1, pt2, Scalar(0, 0, 255), 1, CV_AA);
+/* Classify occupied squares by outline, the Hough detectors only get the unsure ones */
+Board classifyShapes(const Mat& image, Recognizer& recognizer, const Occupancy& occupancy) {
+	Size grid = recognizer.grid;
+	Board board(grid.width, grid.height);
+	Occupancy unsure = occupancy;
+	int unsureCount = 0;
+	for (int r = 0; r < grid.height; r++) {
+		for (int c = 0; c < grid.width; c++) {
+			if (!occupancy.occupied(c, r)) continue;
+			double confidence;
+			PieceShape shape = recognizer.shapes->classify(image(squareRect(image, grid, c, r)), &confidence);
+			if (confidence >= shapeMinConfidence) {
+				board.pieces(c, r) = shape;
+				board.confidence(c, r) = (float)std::min(1.0, confidence);
+				unsure.occupied(c, r) = false;
+			} else {
+				unsureCount++;
+			}
+		}
+	}
+	recognizer.stats.houghFallbacks = unsureCount;
+	if (unsureCount == 0) {
+		return board; // No gradients needed at all
 	}
-	imshow("Canny & HoughLines", cannyImage);
 
-	
-	/*
-	// Split image in checker squares for faster processing
-	int squareWidth = image.cols / 8;
-	int squareHeigth = image.rows / 5;
-	int off = 1;
-	Rect squareSize(0, 0, image.cols / 8 - 2, image.rows / 5 - 2);
-	std::vector<Mat> squares;
-	for (int i = 0; i < 8; i++) {
-		for (int j = 0; j < 5; j++) {
-			squares.push_back(Mat(image, Rect(i*squareWidth + off, j*squareHeigth + off, squareWidth - off, squareHeigth - off)));
+	computeSquareGradients(image, recognizer, unsure);
+	Board fallback = classifySquares(recognizer, unsure);
+	for (int r = 0; r < grid.height; r++) {
+		for (int c = 0; c < grid.width; c++) {
+			if (!unsure.occupied(c, r)) continue;
+			board.pieces(c, r) = fallback.pieces(c, r);
+			board.confidence(c, r) = fallback.confidence(c, r);
 		}
 	}
+	return board;
+}
+
+
+/* Rectify the board, convert to gray and smooth while keeping edges, all in reused buffers */
+void preprocessImage(const Mat& image, Recognizer& recognizer, FrameBuffers& buffers) {
+	rectifyBoard(image, buffers.rectified, recognizer.grid, recognizer.localize);
+	cvtColor(buffers.rectified, buffers.gray, CV_BGR2GRAY);
+	//GaussianBlur(image, image, Size(0, 0), 0.9);
+	//imshow("blurred image", image);
+	denoise(buffers.gray, buffers.filtered, recognizer.denoise, &recognizer.pool, buffers.scratch);
+}
+
+
+/* Find the pieces in a preprocessed image */
+Board detectPieces(const Mat& image, Recognizer& recognizer) {
+	// Find empty squares first so detection is only spent on occupied ones
+	Occupancy occupancy = recognizer.prefilter
+		? findOccupiedSquares(image, recognizer.grid, recognizer.emptySquareStdDev, recognizer.integralSum, recognizer.integralSqSum)
+		: allSquaresOccupied(recognizer.grid);
+	recognizer.stats.prunedSquares = occupancy.pruned;
+	if (recognizer.shapes) {
+		return classifyShapes(image, recognizer, occupancy);
+	}
 
-	for (int i = 0; i < squares.size(); i++) {
-		ghbHex->detect(squares[i], hexPositions);
+	// Sobel and Canny once for every template instead of inside each detector
+	computeGradients(image, recognizer.gradients);
+	if (recognizer.mode == DetectionMode::PER_SQUARE || recognizer.descriptors) {
+		return classifySquares(recognizer, occupancy);
 	}
-	*/
+	return detectFullFrame(image, recognizer, occupancy);
+}
+
+
+/* Process an image */
+Board processImage(const Mat& image, Recognizer& recognizer) {
+	// Show input image
+	showImage(windowName, image, waitTime);
+
+	// Preprocess image
+	FrameBuffers& buffers = recognizer.buffers;
+	preprocessImage(image, recognizer, buffers);
+	showImage(windowName, buffers.filtered, waitTime);
+
+	// Board with grid of detected pieces (c, r)
+	Board board = detectPieces(buffers.filtered, recognizer);
+
+	// Everything below is only for interactive inspection
+	if (!visualize) {
+		return board;
+	}
+
+	printf("\nPruned %i of %i squares as empty\n", recognizer.stats.prunedSquares, recognizer.grid.area());
+	if (recognizer.shapes) {
+		printf("Contour classifier left %i squares to Hough\n", recognizer.stats.houghFallbacks);
+	}
+	printf("\nBoard:\n");
+	printBoard(board, stdout);
+	printf("\nConfidence:\n");
+	printConfidence(board, stdout);
+	printf("\n");
 
 	return board;
 }
 
 
 // Sample board with each piece-type in arbitrary location
-Board createSampleBoard() {
-	Board board;
-	board.pieces[1][1] = PieceShape::CIRCLE;
-	board.pieces[5][1] = PieceShape::A;
-	board.pieces[3][0] = PieceShape::HEX;
-	board.pieces[7][2] = PieceShape::POGRAM;
-	board.pieces[6][2] = PieceShape::STAR;
-	board.pieces[1][4] = PieceShape::TRIANGLE;
+Board createSampleBoard(int width, int height) {
+	Board board(width, height);
+	const int places[][3] = { // Column, row, piece
+		{ 1, 1, (int)PieceShape::CIRCLE },
+		{ 5, 1, (int)PieceShape::A },
+		{ 3, 0, (int)PieceShape::HEX },
+		{ 7, 2, (int)PieceShape::POGRAM },
+		{ 6, 2, (int)PieceShape::STAR },
+		{ 1, 4, (int)PieceShape::TRIANGLE }
+	};
+	for (size_t i = 0; i < sizeof(places) / sizeof(places[0]); i++) {
+		if (places[i][0] < width && places[i][1] < height) { // Smaller boards get fewer pieces
+			board.pieces(places[i][0], places[i][1]) = static_cast<PieceShape>(places[i][2]);
+		}
+	}
 	return board;
 }
 
 
 /* Start point for image processing part */
-Board ip_main() {
+Board ip_main(const HeadlessOptions& options) {
 	// Select image to process
 	std::string fileNames[] = {
 		"easy01.png",
@@ -191,13 +618,76 @@ Board ip_main() {
 
 	// If no valid image is selected, just return sample board
 	if (fileIndex > 3 || fileIndex < 0) {
-		return createSampleBoard();
+		return createSampleBoard(options.boardWidth, options.boardHeight);
 	}
 
 	std::string filename = fileNames[fileIndex];
 	Mat image = readImage("../images/" + filename);
-	Board board = processImage(image);
+	Recognizer recognizer(TemplateBank::load(), options);
+	Board board = processImage(image, recognizer);
 
-	waitKey(0); // Wait a while, wait forever
+	waitForKey(0); // Wait a while, wait forever
 	return board;
 }
+
+
+/* Expand files and directories to a sorted list of image files */
+std::vector<std::string> collectImageFiles(const std::vector<std::string>& inputs) {
+	std::vector<std::string> files;
+	for (int i = 0; i < inputs.size(); i++) {
+		std::vector<std::string> matches;
+		glob(inputs[i], matches, false); // A directory lists its files, a file matches itself
+		for (int j = 0; j < matches.size(); j++) {
+			std::string name = matches[j];
+			std::string ext = name.substr(std::min(name.size(), name.find_last_of('.')));
+			std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+			if (std::find(std::begin(imageExtensions), std::end(imageExtensions), ext) != std::end(imageExtensions)) {
+				files.push_back(name);
+			}
+		}
+	}
+	return files;
+}
+
+
+/* Start point for headless batch recognition, writes one board per image */
+int ip_batch(const std::vector<std::string>& inputs, const HeadlessOptions& options) {
+	setVisualize(false);
+	FILE* out = stdout;
+	if (!options.outputFile.empty()) {
+		out = fopen(options.outputFile.c_str(), "w");
+		if (!out) {
+			throw std::runtime_error("Could not open output file: " + options.outputFile);
+		}
+	}
+
+	std::vector<std::string> files = collectImageFiles(inputs);
+	Recognizer recognizer(TemplateBank::load(), options); // Shared by all images
+	ImageLoader loader(files, options.prefetch, options.mapImages); // Decodes the next images meanwhile
+	int failed = 0, pruned = 0, fallbacks = 0;
+	for (int i = 0; i < files.size(); i++) {
+		try {
+			Board board = processImage(loader.next(), recognizer);
+			pruned += recognizer.stats.prunedSquares;
+			fallbacks += recognizer.stats.houghFallbacks;
+			fprintf(out, "%s\n", files[i].c_str());
+			printBoard(board, out);
+			fprintf(out, "\n");
+		}
+		catch (std::exception& e) { // Bad images should not stop the batch
+			std::cerr << e.what() << std::endl;
+			failed++;
+		}
+	}
+
+	if (out != stdout) fclose(out);
+	std::cerr << "Processed " << files.size() - failed << " of " << files.size() << " images\n";
+	if (options.prefilter) {
+		std::cerr << "Pruned " << pruned << " of " << (files.size() - failed) * recognizer.grid.area()
+			<< " squares as empty\n";
+	}
+	if (options.engine == DetectionEngine::CONTOUR) {
+		std::cerr << "Contour classifier left " << fallbacks << " squares to Hough\n";
+	}
+	return failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
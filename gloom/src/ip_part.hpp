@@ -1,9 +1,12 @@
 #ifndef IP_PART_HPP
 #define IP_PART_HPP
 
+#include <algorithm>
+#include <string>
+#include <vector>
 
-// Allowed piece types
-enum class PieceShape {
+// Allowed piece types, one byte each on a board
+enum class PieceShape : unsigned char {
 	NONE,
 	CIRCLE,
 	A,
@@ -13,16 +16,115 @@ enum class PieceShape {
 	TRIANGLE
 };
 
+// How pieces are found in the image
+enum class DetectionMode {
+	FULL_FRAME, // Every template votes over the whole image
+	PER_SQUARE, // Each occupied square is classified from its own region
+	PYRAMID     // Like FULL_FRAME, coarse-to-fine over several template scales
+};
+
+// What matches the piece templates
+enum class DetectionEngine {
+	HOUGH,   // Generalized Hough voting on edges
+	LINE2D,  // Quantized gradient orientation matching
+	ROTATED, // LINE2D against precomputed rotated and scaled templates, always per square
+	CONTOUR  // Outline shape and Hu moments per square, Hough for the unsure ones
+};
+
+// Edge preserving smoothing before detection
+enum class DenoiseFilter {
+	BILATERAL,  // bilateralFilter(7, 15, 15), the reference
+	SEPARABLE,  // The same weights as a horizontal then a vertical 1D pass
+	GUIDED,     // Self guided filter from box filters
+	DOWNSAMPLED // Bilateral on a half size image, scaled back up
+};
+
+// Command line name of a filter, and back. parseDenoiseFilter returns false
+// for unknown names.
+std::string denoiseFilterName(DenoiseFilter filter);
+bool parseDenoiseFilter(const std::string& name, DenoiseFilter& filter);
+
+/*
+ * One value per square of a board, contiguous in row-major order. Grids of up
+ * to inlineSquares squares (8x8 and all smaller tables) keep their values in
+ * the object itself, so common boards are created, copied and returned
+ * without touching the heap. Only larger grids allocate.
+ */
+template<class T, int inlineSquares = 64>
+class SquareGrid {
+public:
+	SquareGrid(int width, int height, T value = T()) : w(width), h(height) {
+		if (w * h > inlineSquares) heap.resize(w * h);
+		std::fill(data(), data() + w * h, value);
+	}
+
+	int width() const { return w; }
+	int height() const { return h; }
+	int size() const { return w * h; }
+
+	// Square at column c, row r
+	T& operator()(int c, int r) { return data()[r * w + c]; }
+	const T& operator()(int c, int r) const { return data()[r * w + c]; }
+
+	T* data() { return heap.empty() ? inlineValues : heap.data(); }
+	const T* data() const { return heap.empty() ? inlineValues : heap.data(); }
+
+private:
+	int w, h;
+	T inlineValues[inlineSquares];
+	std::vector<T> heap;
+};
+
+// Pieces on a board of any size, by default the 8x5 table the templates and
+// bundled images are made for
 struct Board {
-	// Board size
-	static const int width = 8;
-	static const int height = 5;
+	static const int defaultWidth = 8;
+	static const int defaultHeight = 5;
+
+	explicit Board(int width = defaultWidth, int height = defaultHeight)
+		: pieces(width, height, PieceShape::NONE), confidence(width, height, 0.0f) {}
+
+	int width() const { return pieces.width(); }
+	int height() const { return pieces.height(); }
 
-	PieceShape pieces[width][height] = {};
+	SquareGrid<PieceShape> pieces;
+	SquareGrid<float> confidence; // 0 to 1, of the piece found on each square (0 if none)
 };
 
 
-Board ip_main();
+// Settings for headless batch, archive and stream recognition
+struct HeadlessOptions {
+	std::string outputFile;                        // Boards are written here, stdout if empty
+	DetectionMode mode = DetectionMode::FULL_FRAME;
+	DetectionEngine engine = DetectionEngine::HOUGH;
+	DenoiseFilter denoise = DenoiseFilter::BILATERAL;
+	bool prefilter = true;                         // Skip detection on squares that look empty
+	double emptySquareStdDev = 8.0;                // Gray level std dev below which a square is empty
+	bool localize = false;                         // Find the board grid instead of assuming it fills the image
+	bool track = false;                            // Streams: only reclassify squares that changed
+	int boardWidth = Board::defaultWidth;          // Squares across and down the board
+	int boardHeight = Board::defaultHeight;
+	int workers = 0;                               // Archives: recognition threads, one per hardware thread if 0
+	int prefetch = 4;                              // Batches: images decoded ahead in the background, 0 for none
+	bool mapImages = false;                        // Read image files through memory mappings and imdecode
+};
+
+// Recognize one of the bundled images (or return a sample board) for the
+// interactive viewer, with the board size and detection settings of options
+Board ip_main(const HeadlessOptions& options = HeadlessOptions());
+
+// Recognize every image in the given files/directories without any windows,
+// writing one board per image
+int ip_batch(const std::vector<std::string>& inputs, const HeadlessOptions& options = HeadlessOptions());
+
+// Recognize every image in the given files/directories on several worker
+// threads, each with its own recognizer, writing one JSON line per image as
+// soon as it is done (in completion order)
+int ip_archive(const std::vector<std::string>& inputs, const HeadlessOptions& options = HeadlessOptions());
+
+// Recognize frames from a video file or camera index as they come, writing
+// the board whenever it changes
+int ip_stream(const std::string& source, const HeadlessOptions& options = HeadlessOptions());
 
 
 #endif // !IP_PART_HPP
@@ -0,0 +1,158 @@
+#ifndef IP_PROCESS_HPP
+#define IP_PROCESS_HPP
+
+#include <opencv2/opencv.hpp>
+#include <cstdio>
+#include <string>
+
+#include "ip_part.hpp"
+#include "templateBank.hpp"
+#include "threadPool.hpp"
+#include "pyramidDetector.hpp"
+#include "gradientMap.hpp"
+#include "orientationMatcher.hpp"
+#include "descriptorBank.hpp"
+#include "shapeClassifier.hpp"
+#include "denoise.hpp"
+
+
+// Squares that may hold a piece, found before any shape detection
+struct Occupancy {
+	explicit Occupancy(cv::Size grid, bool value = true)
+		: occupied(grid.width, grid.height, value), pruned(0) {}
+
+	SquareGrid<unsigned char> occupied; // Non-zero if the square may hold a piece
+	int pruned; // Number of squares marked empty
+};
+
+// Measurements from the last processed image
+struct RecognitionStats {
+	int prunedSquares = 0;
+	int houghFallbacks = 0; // Squares the contour classifier left to the Hough detectors
+};
+
+// Images of one frame on its way through preprocessing. Allocated by the first
+// frame and reused by every later one of the same size.
+struct FrameBuffers {
+	cv::Mat input;        // Decoded BGR frame
+	cv::Mat rectified;    // Canonical size BGR, a view of input if that already is
+	cv::Mat gray;
+	cv::Mat filtered;     // Preprocessing result, what detection works on
+	DenoiseScratch scratch;
+};
+
+// Long lived recognition state, reused for every image
+struct Recognizer {
+	explicit Recognizer(const TemplateBank& templates, DetectionMode mode = DetectionMode::FULL_FRAME, int threadCount = 0);
+	Recognizer(const TemplateBank& templates, const HeadlessOptions& options, int threadCount = 0);
+
+	TemplateBank bank;                     // Detectors for the full frame stage
+	ThreadPool pool;                       // Workers for the parallel stages
+	std::vector<TemplateBank> workerBanks; // Own detectors for each square classification task
+	std::unique_ptr<PyramidDetector> pyramid; // Created on first use in PYRAMID mode
+	std::unique_ptr<OrientationMatcher> matcher; // Only with the LINE2D engine, shared by all tasks
+	std::unique_ptr<DescriptorBank> descriptors; // Only with the ROTATED engine, shared by all tasks
+	std::unique_ptr<ShapeClassifier> shapes;     // Only with the CONTOUR engine
+	DetectionMode mode;
+	DetectionEngine engine = DetectionEngine::HOUGH;
+	DenoiseFilter denoise = DenoiseFilter::BILATERAL;
+	bool prefilter = true;                 // Skip detection on squares that look empty
+	double emptySquareStdDev = 8.0;        // Squares closer to uniform than this gray level std dev are empty
+	bool localize = false;                 // Find the board grid instead of assuming it fills the image
+	cv::Size grid = cv::Size(Board::defaultWidth, Board::defaultHeight); // Squares across and down
+	GradientMap gradients;                 // Of the last image, buffers reused for the next one
+	cv::Mat integralSum, integralSqSum;    // Occupancy prefilter buffers, likewise
+	FrameBuffers buffers;                  // For processImage, one image at a time
+	RecognitionStats stats;
+};
+
+
+// Turn HighGUI windows on or off, always off when compiled out with IP_HEADLESS
+void setVisualize(bool enabled);
+
+// Read an image file or throw error if no data
+cv::Mat readImage(std::string filename);
+
+// Expand files and directories to a sorted list of the image files in them
+std::vector<std::string> collectImageFiles(const std::vector<std::string>& inputs);
+
+// Run every template's detector on the gradients of a preprocessed gray image,
+// concurrently if a pool is given. Result i holds the positions (x, y, scale,
+// votes) found for template i, see detectWithVotes.
+std::vector<std::vector<cv::Vec4f>> detectTemplates(const GradientMap& gradients, TemplateBank& bank, ThreadPool* pool = nullptr);
+
+// Area of square (c, r) in a rectified image of a board with grid squares
+// across and down
+cv::Rect squareRect(const cv::Mat& image, cv::Size grid, int c, int r);
+
+// Square (c, r) without the grid lines along its edges
+cv::Rect squareInnerRect(const cv::Mat& image, cv::Size grid, int c, int r);
+cv::Rect insetSquare(const cv::Rect& square);
+
+// Mark squares with a gray level std dev below emptyStdDev as empty, using
+// integral images so the whole board costs one pass over the image
+Occupancy findOccupiedSquares(const cv::Mat& image, cv::Size grid, double emptyStdDev);
+Occupancy findOccupiedSquares(const cv::Mat& image, cv::Size grid, double emptyStdDev, cv::Mat& sum, cv::Mat& sqSum);
+
+// The same test for square (c, r) alone, for when only a few squares matter
+bool squareOccupied(const cv::Mat& image, cv::Size grid, int c, int r, double emptyStdDev);
+
+// Every square marked occupied, for running without the prefilter
+Occupancy allSquaresOccupied(cv::Size grid);
+
+// Confidence (0 to 1) in a detection with relative votes, given the votes of
+// the strongest detection of another template on the same square
+float detectionConfidence(float votes, float runnerUp);
+
+// Put detected template positions (result of detectTemplates) on the board.
+// Non-maximum suppression across templates: strongest detections first, any
+// weaker one within templateMinDist of a kept one is dropped, and the strongest
+// detection on a square wins it. Detections on empty squares are dropped.
+// Fills in the board's confidence from the winner's votes and its margin.
+Board mapDetections(const std::vector<std::vector<cv::Vec4f>>& positions, cv::Size imageSize, const Occupancy& occupancy);
+
+// Vote for every template over the occupied part of the image, the strongest
+// template wins a square. Uses the gradients the recognizer holds for image.
+Board detectFullFrame(const cv::Mat& image, Recognizer& recognizer, const Occupancy& occupancy);
+
+// Classify one square from its own region of the image gradients, with the
+// matcher if given or else the bank's Hough detectors. The strongest template
+// wins, its confidence goes to confidence if given.
+PieceShape classifySquare(const GradientMap& gradients, cv::Size grid, int c, int r, TemplateBank& bank,
+                          const OrientationMatcher* matcher = nullptr, float* confidence = nullptr);
+
+// Classify the occupied squares, spread over the recognizer's pool. Uses the
+// gradients the recognizer holds for the image.
+Board classifySquares(Recognizer& recognizer, const Occupancy& occupancy);
+
+// Gradients of the padded regions around the occupied squares only, with
+// overlapping regions merged and computed once, into
+// recognizer.gradients, enough for classifySquares on those squares
+void computeSquareGradients(const cv::Mat& image, Recognizer& recognizer, const Occupancy& occupancy);
+
+// Classify the occupied squares of a preprocessed image by their outlines,
+// then the unsure ones with the Hough detectors (CONTOUR engine)
+Board classifyShapes(const cv::Mat& image, Recognizer& recognizer, const Occupancy& occupancy);
+
+// Rectify the board in a BGR image to canonical size, convert it to gray and
+// smooth it while keeping edges, into buffers.filtered. Only uses the
+// recognizer's settings and pool, so it may run next to detectPieces on
+// another thread (with other buffers).
+void preprocessImage(const cv::Mat& image, Recognizer& recognizer, FrameBuffers& buffers);
+
+// Find the pieces in a preprocessed image with the recognizer's settings,
+// computing the image gradients shared by all detectors first
+Board detectPieces(const cv::Mat& image, Recognizer& recognizer);
+
+// Recognize the pieces on a board image (preprocess and detect), in the
+// recognizer's buffers
+Board processImage(const cv::Mat& image, Recognizer& recognizer);
+
+// Print board grid (r, c)
+void printBoard(const Board& board, FILE* out);
+
+// Print the confidence of each square, laid out like printBoard
+void printConfidence(const Board& board, FILE* out);
+
+
+#endif // !IP_PROCESS_HPP
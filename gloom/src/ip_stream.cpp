@@ -0,0 +1,173 @@
+#include <algorithm>
+#include <chrono>
+#include <cctype>
+#include <thread>
+
+#include "ip_stream.hpp"
+
+using namespace cv;
+
+
+StreamPipeline::StreamPipeline(VideoCapture& source, Recognizer& recognizer, BoardTracker* tracker, int queueSize)
+	: source(source), recognizer(recognizer), tracker(tracker),
+	  decoded(queueSize), preprocessed(queueSize), detected(queueSize),
+	  buffers(3 * queueSize + 4) {}
+
+
+/* Start the stage threads and emit their results */
+void StreamPipeline::run(const std::function<void(const StreamFrame&)>& emit) {
+	std::thread decodeThread(&StreamPipeline::decodeStage, this);
+	std::thread preprocessThread(&StreamPipeline::preprocessStage, this);
+	std::thread detectThread(&StreamPipeline::detectStage, this);
+
+	StreamFrame frame;
+	try {
+		while (detected.pop(frame)) {
+			emit(frame);
+			buffers.release(frame.buffers);
+		}
+	}
+	catch (...) {
+		fail();
+	}
+
+	decodeThread.join();
+	preprocessThread.join();
+	detectThread.join();
+	if (error) std::rethrow_exception(error);
+}
+
+
+/* Read frames from the source until it runs dry */
+void StreamPipeline::decodeStage() {
+	try {
+		for (int index = 0; ; index++) {
+			StreamFrame frame;
+			frame.index = index;
+			frame.buffers = buffers.acquire();
+			if (!frame.buffers) break; // Stopped
+			Mat& image = frame.buffers->input;
+			if (!source.read(image) || image.empty()) break;
+			if (!decoded.push(std::move(frame))) break; // Stopped downstream
+		}
+	}
+	catch (...) {
+		fail();
+	}
+	decoded.close();
+}
+
+
+void StreamPipeline::preprocessStage() {
+	try {
+		StreamFrame frame;
+		while (decoded.pop(frame)) {
+			preprocessImage(frame.buffers->input, recognizer, *frame.buffers);
+			if (!preprocessed.push(std::move(frame))) break;
+		}
+	}
+	catch (...) {
+		fail();
+	}
+	preprocessed.close();
+	decoded.close(); // Unblock decode if we stopped early
+}
+
+
+void StreamPipeline::detectStage() {
+	try {
+		StreamFrame frame;
+		while (preprocessed.pop(frame)) {
+			const Mat& image = frame.buffers->filtered;
+			if (tracker) {
+				frame.board = tracker->update(image);
+				frame.reclassifiedSquares = tracker->changedSquares();
+			} else {
+				frame.board = detectPieces(image, recognizer);
+				frame.reclassifiedSquares = recognizer.grid.area();
+			}
+			if (!detected.push(std::move(frame))) break;
+		}
+	}
+	catch (...) {
+		fail();
+	}
+	detected.close();
+	preprocessed.close();
+}
+
+
+void StreamPipeline::fail() {
+	{
+		std::lock_guard<std::mutex> lock(errorMutex);
+		if (!error) error = std::current_exception();
+	}
+	decoded.close();
+	preprocessed.close();
+	detected.close();
+	buffers.close();
+}
+
+
+/* Boards are equal if they have the same size and every square holds the same piece */
+bool sameBoard(const Board& a, const Board& b) {
+	if (a.width() != b.width() || a.height() != b.height()) return false;
+	return std::equal(a.pieces.data(), a.pieces.data() + a.pieces.size(), b.pieces.data());
+}
+
+
+/* Start point for stream recognition, source is a video file or camera index */
+int ip_stream(const std::string& source, const HeadlessOptions& options) {
+	setVisualize(false);
+	FILE* out = stdout;
+	if (!options.outputFile.empty()) {
+		out = fopen(options.outputFile.c_str(), "w");
+		if (!out) {
+			throw std::runtime_error("Could not open output file: " + options.outputFile);
+		}
+	}
+
+	VideoCapture capture;
+	bool isCamera = !source.empty() && std::all_of(source.begin(), source.end(),
+		[](char ch) { return ::isdigit((unsigned char)ch) != 0; });
+	if (isCamera ? !capture.open(atoi(source.c_str())) : !capture.open(source)) {
+		if (out != stdout) fclose(out);
+		throw std::runtime_error("Could not open video source: " + source);
+	}
+
+	Recognizer recognizer(TemplateBank::load(), options);
+	BoardTracker tracker(recognizer);
+	StreamPipeline pipeline(capture, recognizer, options.track ? &tracker : nullptr);
+
+	// Write the board whenever it changes
+	Board lastBoard;
+	int frameCount = 0;
+	long reclassified = 0;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	try {
+		pipeline.run([&](const StreamFrame& frame) {
+			if (frame.index == 0 || !sameBoard(frame.board, lastBoard)) {
+				fprintf(out, "frame %i\n", frame.index);
+				printBoard(frame.board, out);
+				fprintf(out, "\n");
+				fflush(out);
+				lastBoard = frame.board;
+			}
+			frameCount++;
+			reclassified += frame.reclassifiedSquares;
+		});
+	}
+	catch (...) {
+		if (out != stdout) fclose(out);
+		throw;
+	}
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	if (out != stdout) fclose(out);
+	fprintf(stderr, "Processed %i frames in %.2f s (%.1f fps)\n", frameCount, seconds,
+		seconds > 0 ? frameCount / seconds : 0.0);
+	if (options.track && frameCount > 0) {
+		fprintf(stderr, "Reclassified %.2f squares per frame\n", (double)reclassified / frameCount);
+	}
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,58 @@
+#ifndef IP_STREAM_HPP
+#define IP_STREAM_HPP
+
+#include <opencv2/opencv.hpp>
+#include <exception>
+#include <functional>
+#include <mutex>
+
+#include "ip_process.hpp"
+#include "boundedQueue.hpp"
+#include "bufferPool.hpp"
+#include "boardTracker.hpp"
+
+
+// A frame moving through the recognition pipeline
+struct StreamFrame {
+	int index = 0;
+	FrameBuffers* buffers = nullptr; // From the pipeline's pool, input after decode, filtered after preprocess
+	Board board;   // Filled in by the detect stage
+	int reclassifiedSquares = 0; // Squares the tracker had to classify again
+};
+
+/*
+ * Recognition of a video source as a pipeline of threads: decode, preprocess
+ * (rectify, gray + bilateral) and detect, with board emit on the calling thread. Stages
+ * hand frames over through bounded queues, so frame N+1 is decoded and
+ * preprocessed while frame N is being detected. Frame images live in a fixed
+ * pool of buffers that go back to decode once a frame is emitted, so a running
+ * pipeline reuses their memory instead of allocating for every frame.
+ */
+class StreamPipeline {
+public:
+	// With a tracker, frames are detected incrementally through it
+	StreamPipeline(cv::VideoCapture& source, Recognizer& recognizer, BoardTracker* tracker = nullptr, int queueSize = 2);
+
+	// Run until the source runs dry, calling emit for every frame in order.
+	// Rethrows the first error from any stage.
+	void run(const std::function<void(const StreamFrame&)>& emit);
+
+private:
+	void decodeStage();
+	void preprocessStage();
+	void detectStage();
+	void fail(); // Record current exception and stop all stages
+
+	cv::VideoCapture& source;
+	Recognizer& recognizer;
+	BoardTracker* tracker;
+	BoundedQueue<StreamFrame> decoded;
+	BoundedQueue<StreamFrame> preprocessed;
+	BoundedQueue<StreamFrame> detected;
+	BufferPool<FrameBuffers> buffers; // Enough for every frame the queues and stages can hold
+	std::mutex errorMutex;
+	std::exception_ptr error;
+};
+
+
+#endif // !IP_STREAM_HPP
@@ -0,0 +1,40 @@
+#include <limits>
+
+#include "levelOfDetail.hpp"
+#include "meshCache.hpp"
+
+
+/* Sphere tessellations, roughly a constant number of pixels per triangle edge */
+LodChain createSphereLod() {
+	const unsigned int slices[] = { 8, 12, 20, 32, 48 };
+	const float minRadiusPixels[] = { 0.0f, 12.0f, 40.0f, 110.0f, 260.0f };
+
+	LodChain chain;
+	for (int i = 0; i < 5; i++) {
+		chain.levels.push_back(cachedMesh(MeshShape::SPHERE, slices[i], slices[i] / 2));
+		chain.minRadiusPixels.push_back(minRadiusPixels[i]);
+	}
+	return chain;
+}
+
+
+/* Radius in pixels of a unit sphere drawn with the model matrix, which scales it uniformly */
+float projectedRadiusPixels(const glm::mat4& model, const glm::mat4& view, const glm::mat4& projection, int viewportHeight) {
+	float radius = glm::length(glm::vec3(model[0]));
+	glm::vec3 center = glm::vec3(view * model[3]);
+	float distance = glm::length(center); // Off to the side counts, not just depth
+
+	if (-center.z < -radius) return 0.0f; // Behind the camera
+	if (distance <= radius) return std::numeric_limits<float>::max(); // Camera is inside or touching it
+	return radius / distance * projection[1][1] * viewportHeight / 2;
+}
+
+
+/* Finest level the projected size calls for */
+VAO_t selectLod(const LodChain& chain, float radiusPixels) {
+	size_t level = 0;
+	while (level + 1 < chain.levels.size() && radiusPixels >= chain.minRadiusPixels[level + 1]) {
+		level++;
+	}
+	return chain.levels[level];
+}
@@ -0,0 +1,23 @@
+#ifndef LEVELOFDETAIL_HPP
+#define LEVELOFDETAIL_HPP
+#pragma once
+
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "shapes.hpp"
+
+
+// Tessellations of one mesh from coarse to fine
+typedef struct LodChain {
+	std::vector<VAO_t> levels;
+	std::vector<float> minRadiusPixels; // Projected radius from which each level is used
+};
+
+
+LodChain createSphereLod();
+float projectedRadiusPixels(const glm::mat4& model, const glm::mat4& view, const glm::mat4& projection, int viewportHeight);
+VAO_t selectLod(const LodChain& chain, float radiusPixels);
+
+
+#endif
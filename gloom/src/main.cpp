@@ -9,6 +9,7 @@
 
 // Standard headers
 #include <cstdlib>
+#include <exception>
 #include <iostream>
 
 
@@ -70,13 +71,112 @@ GLFWwindow* initialise()
 }
 
 
+// Read a board size like 8x5 into options, false if it is not one
+static bool parseBoardSize(const char* text, HeadlessOptions& options)
+{
+	return sscanf(text, "%dx%d", &options.boardWidth, &options.boardHeight) == 2
+		&& options.boardWidth > 0 && options.boardHeight > 0;
+}
+
+
 int main(int argc, char* argb[])
 {
+	// Viewer:
+	//   gloom [--board 8x5]
+	// Headless modes:
+	//   gloom --batch [options] <images or directories>...
+	//   gloom --archive [-j workers] [options] <images or directories>...
+	//   gloom --stream [options] <video file or camera index>
+	// Options: [-o boards.txt] [--per-square | --pyramid] [--engine hough|line2d|rotated|contour] [--no-prefilter]
+	//          [--denoise bilateral|separable|guided|downsampled] [--empty-stddev 8.0] [--localize] [--track]
+	//          [--prefetch 4] [--mmap] [--board 8x5]
+	std::string runMode = argc > 1 ? argb[1] : "";
+	if (runMode == "--batch" || runMode == "--archive" || runMode == "--stream") {
+		std::vector<std::string> inputs;
+		HeadlessOptions options;
+		for (int i = 2; i < argc; i++) {
+			std::string arg = argb[i];
+			if (arg == "-o" && i + 1 < argc) {
+				options.outputFile = argb[++i];
+			} else if (arg == "--per-square") {
+				options.mode = DetectionMode::PER_SQUARE;
+			} else if (arg == "--pyramid") {
+				options.mode = DetectionMode::PYRAMID;
+			} else if (arg == "--engine" && i + 1 < argc) {
+				std::string engine = argb[++i];
+				if (engine == "hough") {
+					options.engine = DetectionEngine::HOUGH;
+				} else if (engine == "line2d") {
+					options.engine = DetectionEngine::LINE2D;
+				} else if (engine == "rotated") {
+					options.engine = DetectionEngine::ROTATED;
+				} else if (engine == "contour") {
+					options.engine = DetectionEngine::CONTOUR;
+				} else {
+					std::cerr << "Unknown engine: " << engine << std::endl;
+					return EXIT_FAILURE;
+				}
+			} else if (arg == "--denoise" && i + 1 < argc) {
+				std::string filter = argb[++i];
+				if (!parseDenoiseFilter(filter, options.denoise)) {
+					std::cerr << "Unknown denoise filter: " << filter << std::endl;
+					return EXIT_FAILURE;
+				}
+			} else if (arg == "--no-prefilter") {
+				options.prefilter = false;
+			} else if (arg == "--empty-stddev" && i + 1 < argc) {
+				options.emptySquareStdDev = atof(argb[++i]);
+			} else if (arg == "--localize") {
+				options.localize = true;
+			} else if (arg == "--track") {
+				options.track = true;
+			} else if (arg == "-j" && i + 1 < argc) {
+				options.workers = atoi(argb[++i]);
+			} else if (arg == "--prefetch" && i + 1 < argc) {
+				options.prefetch = atoi(argb[++i]);
+			} else if (arg == "--mmap") {
+				options.mapImages = true;
+			} else if (arg == "--board" && i + 1 < argc) {
+				if (!parseBoardSize(argb[++i], options)) {
+					std::cerr << "Board size must look like 8x5: " << argb[i] << std::endl;
+					return EXIT_FAILURE;
+				}
+			} else {
+				inputs.push_back(arg);
+			}
+		}
+		try {
+			if (runMode == "--stream") {
+				return ip_stream(inputs.empty() ? "0" : inputs[0], options);
+			}
+			if (runMode == "--archive") {
+				return ip_archive(inputs, options);
+			}
+			return ip_batch(inputs, options);
+		}
+		catch (const std::exception& e) { // Includes cv::Exception from reading and decoding images
+			std::cerr << e.what() << std::endl;
+			return EXIT_FAILURE;
+		}
+	}
+
+	// The viewer only takes the board size, recognition uses the defaults otherwise
+	HeadlessOptions viewerOptions;
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argb[i];
+		if (arg == "--board" && i + 1 < argc) {
+			if (!parseBoardSize(argb[++i], viewerOptions)) {
+				std::cerr << "Board size must look like 8x5: " << argb[i] << std::endl;
+				return EXIT_FAILURE;
+			}
+		}
+	}
+
 	Board board;
 	try {
-		board = ip_main();
+		board = ip_main(viewerOptions);
 	}
-	catch (std::runtime_error e) {
+	catch (const std::exception& e) {
 		std::cerr << e.what() << std::endl;
 		return EXIT_FAILURE;
 	}
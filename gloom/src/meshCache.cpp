@@ -0,0 +1,64 @@
+#include <map>
+#include <tuple>
+
+#include "meshCache.hpp"
+#include "sphere.hpp"
+
+
+// Uploaded meshes by shape and tessellation
+std::map<std::tuple<MeshShape, unsigned int, unsigned int>, VAO_t> meshCache;
+
+// Shading variation baked into the white sphere, scaled by each body's colour
+float sphereColourFlux = 0.2f;
+
+
+/* Shared white mesh for a shape, built and uploaded the first time it is asked for.
+   Slices and layers are only used by spheres, colour comes per instance. */
+VAO_t cachedMesh(MeshShape shape, unsigned int slices, unsigned int layers) {
+	if (shape != MeshShape::SPHERE) {
+		slices = 0;
+		layers = 0;
+	}
+	std::tuple<MeshShape, unsigned int, unsigned int> key(shape, slices, layers);
+	std::map<std::tuple<MeshShape, unsigned int, unsigned int>, VAO_t>::iterator cached = meshCache.find(key);
+	if (cached != meshCache.end()) {
+		return cached->second;
+	}
+
+	VAO_t mesh;
+	switch (shape) {
+	case MeshShape::SLAB:
+		mesh = createSlab(white);
+		break;
+	case MeshShape::HEX:
+		mesh = createHex(white);
+		break;
+	case MeshShape::STAR:
+		mesh = createStar(white);
+		break;
+	case MeshShape::CIRCLE34:
+		mesh = create34thCircle(white);
+		break;
+	case MeshShape::A:
+		mesh = createA(white);
+		break;
+	case MeshShape::TRIANGLE:
+		mesh = createTriangle(white);
+		break;
+	case MeshShape::POGRAM:
+		mesh = createPoGram(white);
+		break;
+	case MeshShape::SPHERE:
+		mesh = createCircleVAO(slices, layers, 1.0f - sphereColourFlux, 1.0f - sphereColourFlux,
+			1.0f - sphereColourFlux, sphereColourFlux);
+		break;
+	}
+	meshCache[key] = mesh;
+	return mesh;
+}
+
+
+/* Number of meshes uploaded so far */
+int cachedMeshCount() {
+	return meshCache.size();
+}
@@ -0,0 +1,25 @@
+#ifndef MESHCACHE_HPP
+#define MESHCACHE_HPP
+#pragma once
+
+#include "shapes.hpp"
+
+
+// Meshes the cache can build
+enum class MeshShape {
+	SLAB,
+	HEX,
+	STAR,
+	CIRCLE34,
+	A,
+	TRIANGLE,
+	POGRAM,
+	SPHERE
+};
+
+
+VAO_t cachedMesh(MeshShape shape, unsigned int slices = 0, unsigned int layers = 0);
+int cachedMeshCount();
+
+
+#endif
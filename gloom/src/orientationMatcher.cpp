@@ -0,0 +1,255 @@
+#include <algorithm>
+#include <cmath>
+
+#include "orientationMatcher.hpp"
+
+#ifdef IP_SSE2
+#include <emmintrin.h>
+#endif
+
+using namespace cv;
+
+// Edge points with a less clear direction than this are not used as features
+const float featureMinCoherence = 0.5f;
+
+
+/* Orientation bin of a direction in degrees */
+int orientationBinOf(double degrees) {
+	degrees = std::fmod(degrees, 180.0);
+	if (degrees < 0) degrees += 180;
+	return std::min((int)(degrees / (180.0 / orientationCount)), orientationCount - 1);
+}
+
+
+/* Sparse edge features of an edge template, direction from the local structure tensor */
+std::vector<Vec3f> extractEdgeFeatures(const Mat& edges, int maxFeatures) {
+	// A one pixel edge has no gradient on itself, so take the dominant
+	// gradient direction of the blurred edges around each point
+	Mat blurred, dx, dy, dxx, dyy, dxy;
+	edges.convertTo(blurred, CV_32F, 1.0 / 255);
+	GaussianBlur(blurred, blurred, Size(5, 5), 0);
+	Sobel(blurred, dx, CV_32F, 1, 0);
+	Sobel(blurred, dy, CV_32F, 0, 1);
+	GaussianBlur(dx.mul(dx), dxx, Size(5, 5), 0);
+	GaussianBlur(dy.mul(dy), dyy, Size(5, 5), 0);
+	GaussianBlur(dx.mul(dy), dxy, Size(5, 5), 0);
+
+	// (x, y, degrees) with coherence, most coherent first
+	std::vector<std::pair<float, Vec3f>> candidates;
+	for (int y = 0; y < edges.rows; y++) {
+		for (int x = 0; x < edges.cols; x++) {
+			if (!edges.at<uchar>(y, x)) continue;
+			float jxx = dxx.at<float>(y, x), jyy = dyy.at<float>(y, x), jxy = dxy.at<float>(y, x);
+			float trace = jxx + jyy;
+			if (trace <= 0) continue;
+			float coherence = std::sqrt((jxx - jyy) * (jxx - jyy) + 4 * jxy * jxy) / trace;
+			if (coherence < featureMinCoherence) continue;
+
+			float degrees = (float)(0.5 * std::atan2(2 * jxy, jxx - jyy) * 180 / CV_PI);
+			candidates.push_back(std::make_pair(coherence, Vec3f((float)x, (float)y, degrees < 0 ? degrees + 180 : degrees)));
+		}
+	}
+	std::stable_sort(candidates.begin(), candidates.end(),
+		[](const std::pair<float, Vec3f>& a, const std::pair<float, Vec3f>& b) { return a.first > b.first; });
+
+	// Spread the features out, growing the distance until few enough are left
+	std::vector<Vec3f> features;
+	for (int minDist = 1; ; minDist++) {
+		features.clear();
+		for (int i = 0; i < candidates.size(); i++) {
+			const Vec3f& candidate = candidates[i].second;
+			bool spaced = true;
+			for (int j = 0; j < features.size() && spaced; j++) {
+				float ddx = features[j][0] - candidate[0], ddy = features[j][1] - candidate[1];
+				spaced = ddx * ddx + ddy * ddy >= minDist * minDist;
+			}
+			if (spaced) features.push_back(candidate);
+		}
+		if (features.size() <= maxFeatures) return features;
+	}
+}
+
+
+// Response of each orientation to every set of spread bits: 4 for the same
+// orientation down to 0 at right angles, best of the bits set
+struct SimilarityTable {
+	uchar lut[orientationCount][256];
+
+	SimilarityTable() {
+		for (int i = 0; i < orientationCount; i++) {
+			for (int bits = 0; bits < 256; bits++) {
+				int best = 0;
+				for (int j = 0; j < orientationCount; j++) {
+					if (!(bits & (1 << j))) continue;
+					int difference = std::abs(i - j);
+					difference = std::min(difference, orientationCount - difference);
+					best = std::max(best, (int)(4 * std::cos(difference * CV_PI / orientationCount) + 1e-6));
+				}
+				lut[i][bits] = (uchar)best;
+			}
+		}
+	}
+};
+const SimilarityTable similarity;
+
+
+/* Add a row of response bytes to a row of scores */
+inline void addResponses(const uchar* responses, ushort* scores, int n) {
+	int x = 0;
+#ifdef IP_SSE2
+	const __m128i zero = _mm_setzero_si128();
+	for (; x + 16 <= n; x += 16) {
+		__m128i r = _mm_loadu_si128((const __m128i*)(responses + x));
+		__m128i lo = _mm_loadu_si128((const __m128i*)(scores + x));
+		__m128i hi = _mm_loadu_si128((const __m128i*)(scores + x + 8));
+		_mm_storeu_si128((__m128i*)(scores + x), _mm_add_epi16(lo, _mm_unpacklo_epi8(r, zero)));
+		_mm_storeu_si128((__m128i*)(scores + x + 8), _mm_add_epi16(hi, _mm_unpackhi_epi8(r, zero)));
+	}
+#endif
+	for (; x < n; x++) {
+		scores[x] += responses[x];
+	}
+}
+
+
+OrientationMatcher::OrientationMatcher(const TemplateBank& bank, double threshold, int maxFeatures)
+	: threshold(threshold) {
+	for (int i = 0; i < bank.size(); i++) {
+		Template templ;
+		templ.size = bank.templateEdges(i).size();
+		CV_Assert(templ.size.width <= 256 && templ.size.height <= 256);
+		std::vector<Vec3f> features = extractEdgeFeatures(bank.templateEdges(i), maxFeatures);
+		for (int j = 0; j < features.size(); j++) {
+			templ.features.push_back(OrientationFeature{
+				(uchar)features[j][0], (uchar)features[j][1], (uchar)orientationBinOf(features[j][2]) });
+		}
+		templates.push_back(templ);
+	}
+}
+
+
+/* Spread the orientations, then look up and linearize the responses */
+void computeResponses(const GradientMap& gradients, ResponseMaps& responses) {
+	const Mat& orientation = gradients.orientation;
+	int cols = orientation.cols, rows = orientation.rows;
+
+	// OR over orientationSpread pixels to the right, then down
+	Mat horizontal = orientation.clone(), spread;
+	for (int d = 1; d < orientationSpread && d < cols; d++) {
+		Mat target = horizontal(Rect(0, 0, cols - d, rows));
+		bitwise_or(target, orientation(Rect(d, 0, cols - d, rows)), target);
+	}
+	spread = horizontal.clone();
+	for (int d = 1; d < orientationSpread && d < rows; d++) {
+		Mat target = spread(Rect(0, 0, cols, rows - d));
+		bitwise_or(target, horizontal(Rect(0, d, cols, rows - d)), target);
+	}
+
+	responses.gridWidth = cols / orientationSpread;
+	responses.gridHeight = rows / orientationSpread;
+	responses.linear.resize(orientationCount * orientationSpread * orientationSpread);
+	for (int o = 0; o < orientationCount; o++) {
+		const uchar* lut = similarity.lut[o];
+		for (int dy = 0; dy < orientationSpread; dy++) {
+			for (int dx = 0; dx < orientationSpread; dx++) {
+				Mat& linear = responses.linear[(o * orientationSpread + dy) * orientationSpread + dx];
+				linear.create(responses.gridHeight, responses.gridWidth, CV_8UC1);
+				for (int y = 0; y < responses.gridHeight; y++) {
+					const uchar* src = spread.ptr<uchar>(y * orientationSpread + dy) + dx;
+					uchar* dst = linear.ptr<uchar>(y);
+					for (int x = 0; x < responses.gridWidth; x++) {
+						dst[x] = lut[src[x * orientationSpread]];
+					}
+				}
+			}
+		}
+	}
+}
+
+
+/* Each feature adds its shifted response grid to the scores */
+void scoreTemplate(const ResponseMaps& responses, const OrientationFeature* features, int featureCount,
+                   Size size, Mat& scores) {
+	int cols = (responses.gridWidth * orientationSpread - size.width) / orientationSpread + 1;
+	int rows = (responses.gridHeight * orientationSpread - size.height) / orientationSpread + 1;
+	if (cols <= 0 || rows <= 0) {
+		scores.release(); // Template does not fit
+		return;
+	}
+
+	scores.create(rows, cols, CV_16UC1);
+	scores.setTo(Scalar(0));
+	for (int j = 0; j < featureCount; j++) {
+		const OrientationFeature& f = features[j];
+		const Mat& linear = responses.at(f.orientation, f.x % orientationSpread, f.y % orientationSpread);
+		int offsetX = f.x / orientationSpread, offsetY = f.y / orientationSpread;
+		for (int y = 0; y < rows; y++) {
+			addResponses(linear.ptr<uchar>(y + offsetY) + offsetX, scores.ptr<ushort>(y), cols);
+		}
+	}
+}
+
+
+/* Score template i at every grid position, keep the best separated peaks */
+std::vector<Vec4f> OrientationMatcher::match(const ResponseMaps& responses, int i) const {
+	const Template& templ = templates[i];
+	std::vector<Vec4f> found;
+	Mat scores;
+	scoreTemplate(responses, templ.features.data(), templ.features.size(), templ.size, scores);
+	if (scores.empty() || templ.features.empty()) {
+		return found;
+	}
+	int rows = scores.rows, cols = scores.cols;
+
+	// Strongest first, skipping positions too close to a stronger one
+	int minScore = (int)std::ceil(threshold * 4 * templ.features.size());
+	std::vector<std::pair<int, Point>> peaks;
+	for (int y = 0; y < rows; y++) {
+		const ushort* row = scores.ptr<ushort>(y);
+		for (int x = 0; x < cols; x++) {
+			if (row[x] >= minScore) peaks.push_back(std::make_pair((int)row[x], Point(x, y)));
+		}
+	}
+	std::stable_sort(peaks.begin(), peaks.end(),
+		[](const std::pair<int, Point>& a, const std::pair<int, Point>& b) { return a.first > b.first; });
+	for (int j = 0; j < peaks.size(); j++) {
+		Vec4f center(peaks[j].second.x * orientationSpread + templ.size.width / 2.0f,
+		             peaks[j].second.y * orientationSpread + templ.size.height / 2.0f, 1,
+		             peaks[j].first / (4.0f * templ.features.size())); // Score relative to a perfect match
+		bool separate = true;
+		for (int k = 0; k < found.size() && separate; k++) {
+			float dx = found[k][0] - center[0], dy = found[k][1] - center[1];
+			separate = dx * dx + dy * dy >= templateMinDist * templateMinDist;
+		}
+		if (separate) found.push_back(center);
+	}
+	return found;
+}
+
+
+/* Responses once, then every template, concurrently if a pool is given */
+std::vector<std::vector<Vec4f>> OrientationMatcher::detect(const GradientMap& gradients, ThreadPool* pool) const {
+	ResponseMaps responses;
+	computeResponses(gradients, responses);
+
+	std::vector<std::vector<Vec4f>> positions(templates.size());
+	if (!pool) {
+		for (int i = 0; i < templates.size(); i++) {
+			positions[i] = match(responses, i);
+		}
+		return positions;
+	}
+
+	// Matching only reads the matcher and the responses
+	std::vector<std::future<void>> done;
+	for (int i = 0; i < templates.size(); i++) {
+		std::vector<Vec4f>* templPositions = &positions[i];
+		done.push_back(pool->submit([this, &responses, templPositions, i]() {
+			*templPositions = match(responses, i);
+		}));
+	}
+	for (int i = 0; i < done.size(); i++) {
+		done[i].get();
+	}
+	return positions;
+}
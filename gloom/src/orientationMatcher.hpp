@@ -0,0 +1,86 @@
+#ifndef ORIENTATION_MATCHER_HPP
+#define ORIENTATION_MATCHER_HPP
+
+#include <opencv2/opencv.hpp>
+#include <vector>
+
+#include "templateBank.hpp"
+#include "threadPool.hpp"
+#include "gradientMap.hpp"
+
+
+// Orientations are spread over, and matches evaluated on, cells of this size
+const int orientationSpread = 4;
+// Fraction of the best possible score a match needs
+const double orientationMatchThreshold = 0.8;
+// Features sampled along each template's edges
+const int orientationMaxFeatures = 64;
+
+// Per orientation similarity to the spread image orientations, linearized: for
+// every offset (dx, dy) inside a spread cell, the responses at
+// (x * spread + dx, y * spread + dy) are one contiguous grid
+struct ResponseMaps {
+	std::vector<cv::Mat> linear; // [orientation][dy][dx] flattened, CV_8UC1 gridHeight x gridWidth
+	int gridWidth = 0, gridHeight = 0;
+
+	const cv::Mat& at(int orientation, int dx, int dy) const {
+		return linear[(orientation * orientationSpread + dy) * orientationSpread + dx];
+	}
+};
+
+// One template edge point, templates are at most 256 pixels wide and high
+struct OrientationFeature {
+	unsigned char x, y;        // Offset from the template's top left corner
+	unsigned char orientation; // Bin of the edge normal
+};
+
+// Orientation bin of a direction in degrees (modulo 180)
+int orientationBinOf(double degrees);
+
+// Up to maxFeatures well spread points (x, y, degrees) along the edges of an
+// edge template, with the direction of the edge normal
+std::vector<cv::Vec3f> extractEdgeFeatures(const cv::Mat& edges, int maxFeatures);
+
+// Spread the orientations of a gradient map (or a view of one) and compute
+// the linearized response maps
+void computeResponses(const GradientMap& gradients, ResponseMaps& responses);
+
+// Score (CV_16UC1) of a template of the given size at every grid position,
+// up to 4 per feature. Empty if the template does not fit.
+void scoreTemplate(const ResponseMaps& responses, const OrientationFeature* features, int featureCount,
+                   cv::Size size, cv::Mat& scores);
+
+/*
+ * Template matching on quantized gradient orientations, after LINE-2D.
+ * Each template is a sparse set of edge points with their orientation. Image
+ * orientations are spread (OR of bits) over a small neighbourhood so matches
+ * tolerate small shifts and deformations, then turned into a response map per
+ * orientation with a lookup table. Scoring a template position is a sum of
+ * response bytes, done for a whole grid row at a time with SIMD adds.
+ */
+class OrientationMatcher {
+public:
+	explicit OrientationMatcher(const TemplateBank& bank, double threshold = orientationMatchThreshold,
+	                            int maxFeatures = orientationMaxFeatures);
+
+	// Centers (x, y, 1, score) of template i over the responses, at most one
+	// within templateMinDist of another. Scores are relative to a perfect match.
+	std::vector<cv::Vec4f> match(const ResponseMaps& responses, int i) const;
+
+	// All templates, like detectTemplates(). Concurrent if a pool is given.
+	std::vector<std::vector<cv::Vec4f>> detect(const GradientMap& gradients, ThreadPool* pool = nullptr) const;
+
+	int size() const { return templates.size(); }
+
+private:
+	struct Template {
+		cv::Size size;
+		std::vector<OrientationFeature> features;
+	};
+
+	double threshold;
+	std::vector<Template> templates;
+};
+
+
+#endif // !ORIENTATION_MATCHER_HPP
@@ -1,5 +1,6 @@
 
 #include <cmath>
+#include <cstddef>
 
 // Local headers
 #include "program.hpp"
@@ -8,6 +9,9 @@
 #include "sphere.hpp"
 #include "sceneGraph.hpp"
 #include "shapes.hpp"
+#include "meshCache.hpp"
+#include "instancedMesh.hpp"
+#include "levelOfDetail.hpp"
 #include "ip_part.hpp"
 
 #include "glm/glm.hpp"
@@ -48,14 +52,41 @@ float defaultPieceScale = 0.8;
 float selectedPieceHeight = 3.0;
 float pieceAniSpeed = 5.0; // Move n per second in world coordinates (square is 2.0 wide)
 float aniStopDelta = 0.03; // 0.03 should be ok down to ~33 fps
+float tableMargin = 2.0; // Table edge outside the outer squares, in half squares
 // Keep an indexable list of pieces
 std::vector<SceneNode*> pieces;
+// Meshes shared by the table, squares and pieces, each drawn with one instanced call
+std::vector<InstancedMesh> instancedMeshes;
+// Sphere tessellations for the planets and moons
+LodChain sphereLod;
+
+
+// Interleaved vertex as uploaded by setupVAO, 16 bytes
+typedef struct PackedVertex {
+	float position[3];
+	unsigned char colour[4]; // Normalized RGBA
+};
 
 
 /**
-  * A function which sets up a Vertex Array Object (VAO) containing triangles
+  * A function which sets up a Vertex Array Object (VAO) containing triangles.
+  * Positions and colours are interleaved into one buffer with the colour packed into
+  * four bytes, and indices are stored as 16 bits whenever the vertex count allows it.
   */
-unsigned int setupVAO(float* vertices, int v_size, unsigned int* indices, int i_size, float* colours, int c_size) {
+VAO_t setupVAO(float* vertices, int v_size, unsigned int* indices, int i_size, float* colours, int c_size) {
+    int vertexCount = v_size / 3;
+    std::vector<PackedVertex> packed(vertexCount);
+    for (int i = 0; i < vertexCount; i++) {
+        for (int k = 0; k < 3; k++) {
+            packed[i].position[k] = vertices[3 * i + k];
+        }
+        for (int k = 0; k < 4; k++) {
+            float channel = 4 * i + k < c_size ? colours[4 * i + k] : 1.0f;
+            channel = channel < 0.0f ? 0.0f : (channel > 1.0f ? 1.0f : channel);
+            packed[i].colour[k] = (unsigned char)(channel * 255.0f + 0.5f);
+        }
+    }
+
     // Set up VAO
     unsigned int arrayID = 0;
     glGenVertexArrays(1, &arrayID);
@@ -65,7 +96,7 @@ unsigned int setupVAO(float* vertices, int v_size, unsigned int* indices, int i_
     unsigned int bufferID = 0;
     glGenBuffers(1, &bufferID);
     glBindBuffer(GL_ARRAY_BUFFER, bufferID);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(float)*v_size, vertices, GL_STATIC_DRAW);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(PackedVertex)*vertexCount, packed.data(), GL_STATIC_DRAW);
     /*
     void glVertexAttribPointer(
         unsigned int index,
@@ -76,25 +107,79 @@ unsigned int setupVAO(float* vertices, int v_size, unsigned int* indices, int i_
         void* pointer
     );
     */
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, 0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, position));
     glEnableVertexAttribArray(0);
 
-    // Add colour VBO
-    unsigned int colourBufferID = 0;
-    glGenBuffers(1, &colourBufferID);
-    glBindBuffer(GL_ARRAY_BUFFER, colourBufferID);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(float)*c_size, colours, GL_STATIC_DRAW);
-    glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, 0, 0);
+    // Colour from the same buffer, bytes scaled to 0-1 for the shader
+    glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, colour));
     glEnableVertexAttribArray(1);
 
     // Set up index buffer
     unsigned int i_bufferID = 0;
     glGenBuffers(1, &i_bufferID);
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, i_bufferID);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned int)*i_size, indices, GL_STATIC_DRAW);
+    unsigned int indexType = GL_UNSIGNED_INT;
+    if (vertexCount <= 65536) {
+        std::vector<unsigned short> shortIndices(indices, indices + i_size);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned short)*i_size, shortIndices.data(), GL_STATIC_DRAW);
+        indexType = GL_UNSIGNED_SHORT;
+    } else {
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned int)*i_size, indices, GL_STATIC_DRAW);
+    }
 
     // Return VAO ID
-    return arrayID;
+    return VAO_t{ arrayID, i_size, indexType };
+}
+
+
+/* Colour as a vector for instance and vertex attributes */
+glm::vec4 colourVector(colour_t colour) {
+	return glm::vec4(colour.red, colour.green, colour.blue, colour.alpha);
+}
+
+
+/* Shared mesh and colour for a piece shape, false if there is no piece */
+bool pieceModel(PieceShape shape, MeshShape& mesh, colour_t& colour) {
+	switch (shape) {
+	case PieceShape::CIRCLE:
+		mesh = MeshShape::CIRCLE34;
+		colour = circleColour;
+		return true;
+	case PieceShape::A:
+		mesh = MeshShape::A;
+		colour = aColour;
+		return true;
+	case PieceShape::HEX:
+		mesh = MeshShape::HEX;
+		colour = hexColour;
+		return true;
+	case PieceShape::POGRAM:
+		mesh = MeshShape::POGRAM;
+		colour = poGramColour;
+		return true;
+	case PieceShape::STAR:
+		mesh = MeshShape::STAR;
+		colour = starColour;
+		return true;
+	case PieceShape::TRIANGLE:
+		mesh = MeshShape::TRIANGLE;
+		colour = triangleColour;
+		return true;
+	default:
+		return false;
+	}
+}
+
+
+/* Index of the instanced batch for a cached mesh, created the first time the mesh is used */
+int instancedMesh(MeshShape shape) {
+	static std::vector<int> batches(static_cast<int>(MeshShape::SPHERE) + 1, -1);
+	int& index = batches[static_cast<int>(shape)];
+	if (index < 0) {
+		index = instancedMeshes.size();
+		instancedMeshes.push_back(createInstancedMesh(cachedMesh(shape)));
+	}
+	return index;
 }
 
 
@@ -103,73 +188,61 @@ unsigned int setupVAO(float* vertices, int v_size, unsigned int* indices, int i_
   */
 SceneNode* setupSceneGraph() {
 	unsigned int slices = 20, layers = 10;
-	int indiceCount = slices * layers * 2 * 3; // slices * layers * PRIMITIVES_PER_RECTANGLE * VERTICES_PER_TRIANGLE
+
+	// One slab for the table and every square, coloured per instance
+	int slabMesh = instancedMesh(MeshShape::SLAB);
+	VAO_t slabModel = instancedMeshes[slabMesh].mesh;
+	VAO_t sphereModel = cachedMesh(MeshShape::SPHERE, slices, layers);
+	sphereLod = createSphereLod();
 
 	// Center node
 	SceneNode* table = createSceneNode();
-	VAO_t tableModel = createSlab(colour_t{ 0.4f, 0.25f, 0.2f, 1.0f, 0.0f });
-	table->vertexArrayObjectID = tableModel.vaoID;
-	table->indexCount = tableModel.indexCount;
+	table->vertexArrayObjectID = slabModel.vaoID;
+	table->indexCount = slabModel.indexCount;
+	table->indexType = slabModel.indexType;
+	table->instancedMesh = slabMesh;
+	table->colour = glm::vec4(0.4f, 0.25f, 0.2f, 1.0f);
 	table->rotationSpeedRadians = 0;
 	table->orbitSpeedRadians = 0;
 	table->rotationDirection = glm::vec3(0.0, 1.0, 0.0);
-	table->scaleVector = glm::vec3(10.0, 5.0, 10.0);
+	table->scaleVector = glm::vec3(board.width() + tableMargin, 5.0, board.height() + tableMargin); // Grows with the board
 	table->y = -0.5;
 
 	// Checkerboard and pieces
-	for (int col = 0; col < board.width; col++) {
-		for (int row = 0; row < board.height; row++) {
+	for (int col = 0; col < board.width(); col++) {
+		for (int row = 0; row < board.height(); row++) {
 			SceneNode* square = createSceneNode();
-			colour_t colour;
 			if (col % 2 == row % 2) {
-				colour = { 0.7f, 0.0f, 0.0f, 1.0f, 0.0f };
+				square->colour = glm::vec4(0.7f, 0.0f, 0.0f, 1.0f);
 			} else {
-				colour = { 0.0f, 0.0f, 0.7f, 1.0f, 0.0f };
+				square->colour = glm::vec4(0.0f, 0.0f, 0.7f, 1.0f);
 			}
-			VAO_t squareModel = createSlab(colour);
-			square->vertexArrayObjectID = squareModel.vaoID;
-			square->indexCount = squareModel.indexCount;
+			square->vertexArrayObjectID = slabModel.vaoID;
+			square->indexCount = slabModel.indexCount;
+			square->indexType = slabModel.indexType;
+			square->instancedMesh = slabMesh;
 
 			square->y = 0.6;
-			square->x = 2 * col - (float)board.width + 1;
-			square->z = 2 * row - (float)board.height + 1;
+			square->x = 2 * col - (float)board.width() + 1;
+			square->z = 2 * row - (float)board.height() + 1;
 
 			addChild(table, square);
 
 			// Pieces
-			VAO_t pieceModel;
-			switch (board.pieces[col][row]) {
-			case PieceShape::NONE:
+			MeshShape pieceShape;
+			colour_t pieceColour;
+			if (!pieceModel(board.pieces(col, row), pieceShape, pieceColour)) {
 				continue; // Skip rest of loop if no piece
-				break;
-			case PieceShape::CIRCLE:
-				pieceModel = create34thCircle();
-				break;
-			case PieceShape::A:
-				pieceModel = createA();
-				break;
-			case PieceShape::HEX:
-				pieceModel = createHex();
-				break;
-			case PieceShape::POGRAM:
-				pieceModel = createPoGram();
-				break;
-			case PieceShape::STAR:
-				pieceModel = createStar();
-				break;
-			case PieceShape::TRIANGLE:
-				pieceModel = createTriangle();
-				break;
-			default:
-				continue;
-				break;
 			}
 			SceneNode* piece = createSceneNode();
-			piece->vertexArrayObjectID = pieceModel.vaoID;
-			piece->indexCount = pieceModel.indexCount;
+			piece->instancedMesh = instancedMesh(pieceShape);
+			piece->vertexArrayObjectID = instancedMeshes[piece->instancedMesh].mesh.vaoID;
+			piece->indexCount = instancedMeshes[piece->instancedMesh].mesh.indexCount;
+			piece->indexType = instancedMeshes[piece->instancedMesh].mesh.indexType;
+			piece->colour = colourVector(pieceColour);
 			piece->y = 0.9;
-			piece->x = 2 * col - (float)board.width + 1;
-			piece->z = 2 * row - (float)board.height + 1;
+			piece->x = 2 * col - (float)board.width() + 1;
+			piece->z = 2 * row - (float)board.height() + 1;
 			piece->scaleVector = glm::vec3(defaultPieceScale);
 			piece->modelType = ModelType::PIECESHAPE;
 			piece->pieceGridPos = glm::vec2(col, row);
@@ -179,7 +252,7 @@ SceneNode* setupSceneGraph() {
 		}
 	}
 	// Set height so we can see the default selected piece
-	pieces[selectedPiece]->scaleVector[1] = selectedPieceHeight;
+	if (!pieces.empty()) pieces[selectedPiece]->scaleVector[1] = selectedPieceHeight;
 	
 
 
@@ -187,8 +260,11 @@ SceneNode* setupSceneGraph() {
 
 	// planet 2
 	SceneNode* planet2 = createSceneNode();
-	planet2->vertexArrayObjectID = createCircleVAO(slices, layers, 0.1, 0.2, 0.7, 0.1);
-	planet2->indexCount = indiceCount;
+	planet2->vertexArrayObjectID = sphereModel.vaoID;
+	planet2->indexCount = sphereModel.indexCount;
+	planet2->indexType = sphereModel.indexType;
+	planet2->lod = &sphereLod;
+	planet2->colour = glm::vec4(0.1, 0.2, 0.7, 1.0);
 	planet2->rotationDirection = glm::vec3(0.0, 1.0, 0.0);
 	planet2->rotationSpeedRadians = PI / 20;
 	planet2->orbitSpeedRadians = PI / 50;
@@ -198,8 +274,11 @@ SceneNode* setupSceneGraph() {
 	planet2->z = -20;
 
 	SceneNode* planet2_moon = createSceneNode();
-	planet2_moon->vertexArrayObjectID = createCircleVAO(slices, layers, 0.0, 0.0, 0.4, 0.1);
-	planet2_moon->indexCount = indiceCount;
+	planet2_moon->vertexArrayObjectID = sphereModel.vaoID;
+	planet2_moon->indexCount = sphereModel.indexCount;
+	planet2_moon->indexType = sphereModel.indexType;
+	planet2_moon->lod = &sphereLod;
+	planet2_moon->colour = glm::vec4(0.0, 0.0, 0.4, 1.0);
 	planet2_moon->rotationDirection = glm::vec3(0.0, 1.0, 0.0);
 	planet2_moon->rotationSpeedRadians = PI / 10;
 	planet2_moon->orbitSpeedRadians = PI / 10;
@@ -210,8 +289,11 @@ SceneNode* setupSceneGraph() {
 
 	// planet 3
 	SceneNode* planet3 = createSceneNode();
-	planet3->vertexArrayObjectID = createCircleVAO(slices, layers, 0.8, 0.3, 0.1, 0.1);
-	planet3->indexCount = indiceCount;
+	planet3->vertexArrayObjectID = sphereModel.vaoID;
+	planet3->indexCount = sphereModel.indexCount;
+	planet3->indexType = sphereModel.indexType;
+	planet3->lod = &sphereLod;
+	planet3->colour = glm::vec4(0.8, 0.3, 0.1, 1.0);
 	planet3->rotationDirection = glm::vec3(0.0, -1.0, 0.0);
 	planet3->rotationSpeedRadians = PI / 60;
 	planet3->orbitSpeedRadians = PI / 70;
@@ -221,8 +303,11 @@ SceneNode* setupSceneGraph() {
 	planet3->z = -19;
 
 	SceneNode* planet3_moon = createSceneNode();
-	planet3_moon->vertexArrayObjectID = createCircleVAO(slices, layers, 0.5, 0.1, 0.0, 0.1);
-	planet3_moon->indexCount = indiceCount;
+	planet3_moon->vertexArrayObjectID = sphereModel.vaoID;
+	planet3_moon->indexCount = sphereModel.indexCount;
+	planet3_moon->indexType = sphereModel.indexType;
+	planet3_moon->lod = &sphereLod;
+	planet3_moon->colour = glm::vec4(0.5, 0.1, 0.0, 1.0);
 	planet3_moon->rotationDirection = glm::vec3(0.0, -1.0, 0.0);
 	planet3_moon->rotationSpeedRadians = PI / 30;
 	planet3_moon->orbitSpeedRadians = PI / 15;
@@ -233,8 +318,11 @@ SceneNode* setupSceneGraph() {
 
 	// planet 4
 	SceneNode* planet4 = createSceneNode();
-	planet4->vertexArrayObjectID = createCircleVAO(slices, layers, 0.1, 0.5, 0.1, 0.1);
-	planet4->indexCount = indiceCount;
+	planet4->vertexArrayObjectID = sphereModel.vaoID;
+	planet4->indexCount = sphereModel.indexCount;
+	planet4->indexType = sphereModel.indexType;
+	planet4->lod = &sphereLod;
+	planet4->colour = glm::vec4(0.1, 0.5, 0.1, 1.0);
 	planet4->rotationDirection = glm::vec3(0.0, 1.0, 0.0);
 	planet4->rotationSpeedRadians = PI / 90;
 	planet4->orbitSpeedRadians = PI / 120;
@@ -245,8 +333,11 @@ SceneNode* setupSceneGraph() {
 
 	// planet 5
 	SceneNode* planet5 = createSceneNode();
-	planet5->vertexArrayObjectID = createCircleVAO(slices, layers, 0.2, 0.3, 0.3, 0.1);
-	planet5->indexCount = indiceCount;
+	planet5->vertexArrayObjectID = sphereModel.vaoID;
+	planet5->indexCount = sphereModel.indexCount;
+	planet5->indexType = sphereModel.indexType;
+	planet5->lod = &sphereLod;
+	planet5->colour = glm::vec4(0.2, 0.3, 0.3, 1.0);
 	planet5->rotationDirection = glm::vec3(0.0, 1.0, 0.0);
 	planet5->rotationSpeedRadians = PI / 40;
 	planet5->orbitSpeedRadians = PI / 200;
@@ -282,8 +373,8 @@ void traverseSceneGraph(SceneNode* sceneGraph, double timeDelta) {
 		int row = sceneGraph->pieceGridPos[1];
 		float xOff = sceneGraph->aniOffset[0];
 		float zOff = sceneGraph->aniOffset[1];
-		sceneGraph->x = 2 * col - (float)board.width + 1 + xOff;
-		sceneGraph->z = 2 * row - (float)board.height + 1 + zOff;
+		sceneGraph->x = 2 * col - (float)board.width() + 1 + xOff;
+		sceneGraph->z = 2 * row - (float)board.height() + 1 + zOff;
 
 		// Update piece animation
 		if (sceneGraph->isAnimating) {
@@ -322,6 +413,21 @@ void traverseSceneGraph(SceneNode* sceneGraph, double timeDelta) {
 }
 
 
+/* Draw a node from its own VAO, at the detail its size on screen calls for. Returns triangles drawn. */
+int drawNode(SceneNode* node, glm::mat4 model, glm::mat4 view, glm::mat4 projection) {
+	VAO_t mesh = VAO_t{ (unsigned int)node->vertexArrayObjectID, (int)node->indexCount, node->indexType };
+	if (node->lod) {
+		mesh = selectLod(*node->lod, projectedRadiusPixels(model, view, projection, windowHeight));
+	}
+	glBindVertexArray(mesh.vaoID);
+	setSingleInstance(node->colour); // Not instanced, colour as a constant attribute
+	glm::mat4 MVP = projection * view * model;
+	glUniformMatrix4fv(2, 1, GL_FALSE, glm::value_ptr(MVP));
+	glDrawElements(GL_TRIANGLES, mesh.indexCount, mesh.indexType, 0);
+	return mesh.indexCount / 3;
+}
+
+
 void runProgram(GLFWwindow* window, Board checkerboard)
 {
 	board = checkerboard;
@@ -361,6 +467,7 @@ void runProgram(GLFWwindow* window, Board checkerboard)
 	glm::mat4 projection = glm::perspective(vertAngleRad, (float)windowWidth/windowHeight, 0.1f, 100.0f);
     int count = 0; // Frame counter
 	float timeCount = 0; // Time counter
+	long triangleCount = 0; // Triangles drawn for nodes with their own VAO
 	getTimeDeltaSeconds(); // Reset before rendering starts
     /////////////////
     // Rendering Loop
@@ -414,9 +521,10 @@ void runProgram(GLFWwindow* window, Board checkerboard)
         glm::mat4 view2 = glm::rotate(camPos.dirVert, glm::vec3(1.0, 0.0, 0.0)); // Rotate world vertically around camera
 		glm::mat4 view = view2 * view1 * view0;
 
-		// Render sun, planets and moons
+		glm::mat4 viewProjection = projection * view;
+
+		// Render sun, planets and moons, nodes with a shared mesh are gathered for later
 		SceneNode* sun = sceneGraph; // Rename for better readability
-		glBindVertexArray(sun->vertexArrayObjectID);
 		// The following transformations must be done here to avoid affecting the entire system
 		glm::mat4 model0 = glm::rotate((float)PI / 2, glm::vec3(1.0, 0.0, 0.0)); // Rotate body 90 degrees to avoid "the eye"
 		glm::mat4 model1 = glm::scale(sun->scaleVector); // Scale here to avoid scaling entire system
@@ -424,38 +532,44 @@ void runProgram(GLFWwindow* window, Board checkerboard)
 
 		glm::mat4 sunModel = sun->currentTransformationMatrix;
 		glm::mat4 model = sunModel * model2 * model1; // Complete model transformation  * model0
-		glm::mat4 MVP = projection * view * model;
-		glUniformMatrix4fv(2, 1, GL_FALSE, glm::value_ptr(MVP));
-		glDrawElements(GL_TRIANGLES, sun->indexCount, GL_UNSIGNED_INT, 0);
+		if (sun->instancedMesh >= 0) {
+			instancedMeshes[sun->instancedMesh].instances.push_back(InstanceData{ model, sun->colour });
+		} else {
+			triangleCount += drawNode(sun, model, view, projection);
+		}
 
-		for (int i = 0; i < sun->children.size(); i++) { // Planets
+		for (int i = 0; i < sun->children.size(); i++) { // Planets, squares and pieces
 			SceneNode* planet = sun->children[i];
-			glBindVertexArray(planet->vertexArrayObjectID);
 			model0 = glm::rotate((float)PI / 2, glm::vec3(1.0, 0.0, 0.0));
 			model1 = glm::scale(planet->scaleVector);
 			model2 = glm::rotate(timeCount*planet->rotationSpeedRadians, planet->rotationDirection);
 
 			glm::mat4 planetModel = planet->currentTransformationMatrix;
 			model = sunModel * planetModel * model2 * model1;
-			MVP = projection * view * model;
-			glUniformMatrix4fv(2, 1, GL_FALSE, glm::value_ptr(MVP));
-			glDrawElements(GL_TRIANGLES, planet->indexCount, GL_UNSIGNED_INT, 0);
+			if (planet->instancedMesh >= 0) {
+				instancedMeshes[planet->instancedMesh].instances.push_back(InstanceData{ model, planet->colour });
+			} else {
+				triangleCount += drawNode(planet, model, view, projection);
+			}
 
 			for (int j = 0; j < planet->children.size(); j++) { // Moons
 				SceneNode* moon = planet->children[j];
-				glBindVertexArray(moon->vertexArrayObjectID);
 				model0 = glm::rotate((float)PI / 2, glm::vec3(1.0, 0.0, 0.0));
 				model1 = glm::scale(moon->scaleVector);
 				model2 = glm::rotate(timeCount*moon->rotationSpeedRadians, moon->rotationDirection);
 
 				glm::mat4 moonModel = moon->currentTransformationMatrix;
 				model = sunModel * planetModel * moonModel * model2 * model1 * model0;
-				MVP = projection * view * model;
-				glUniformMatrix4fv(2, 1, GL_FALSE, glm::value_ptr(MVP));
-				glDrawElements(GL_TRIANGLES, moon->indexCount, GL_UNSIGNED_INT, 0);
+				triangleCount += drawNode(moon, model, view, projection);
 			}
 
 		}
+
+		// Table, squares and pieces, one draw call per shape
+		glUniformMatrix4fv(2, 1, GL_FALSE, glm::value_ptr(viewProjection));
+		for (int i = 0; i < instancedMeshes.size(); i++) {
+			drawInstances(instancedMeshes[i]);
+		}
         
 
         //glDrawElements(GL_TRIANGLES, sphereIndiceCount, GL_UNSIGNED_INT, 0);
@@ -471,11 +585,13 @@ void runProgram(GLFWwindow* window, Board checkerboard)
 	// Calculate and print average frames per second
 	float frameRate = count / timeCount;
 	printf("Average framerate: %f\n", frameRate);
+	printf("Average planet and moon triangles per frame: %ld\n", count > 0 ? triangleCount / count : 0);
 }
 
 
 // Visualize selected piece by increasing height of model
 void changeSelectedPiece() {
+	if (pieces.empty()) return; // Small boards can have no pieces at all
 	SceneNode* currentSelPiece = pieces[selectedPiece];
 	selectedPiece = ++selectedPiece % pieces.size();
 	SceneNode* nextSelPiece = pieces[selectedPiece];
@@ -489,21 +605,17 @@ void changeSelectedPiece() {
 // Check if 2 pieces collide or if pos outside board
 bool checkPieceCollision(glm::vec2 pos) {
 	// Check offboard position
-	if (pos[0] < 0 || pos[0] > board.width-1 || pos[1] < 0 || pos[1] > board.height-1) {
+	if (pos[0] < 0 || pos[0] > board.width()-1 || pos[1] < 0 || pos[1] > board.height()-1) {
 		return true;
 	}
-	// Check piece collision
-	for (int i = 0; i < pieces.size(); i++) {
-		if (pieces[i]->pieceGridPos == pos) {
-			return true;
-		}
-	}
-	return false;
+	// Check piece collision, the board follows every move
+	return board.pieces((int)pos[0], (int)pos[1]) != PieceShape::NONE;
 }
 
 
 // Move the selected piece
 void movePiece(int dCol, int dRow) {
+	if (pieces.empty()) return;
 	SceneNode* selPiece = pieces[selectedPiece];
 	if (selPiece->isAnimating) return; // Do not allow movement if animating
 	glm::vec2 oldPos = selPiece->pieceGridPos;
@@ -512,6 +624,8 @@ void movePiece(int dCol, int dRow) {
 	if (checkPieceCollision(newPos)) {
 		return;
 	} else {
+		board.pieces((int)newPos[0], (int)newPos[1]) = board.pieces((int)oldPos[0], (int)oldPos[1]);
+		board.pieces((int)oldPos[0], (int)oldPos[1]) = PieceShape::NONE;
 		selPiece->pieceGridPos = newPos;
 		selPiece->isAnimating = true;
 		selPiece->aniOffset[0] = -2.0f * dCol;
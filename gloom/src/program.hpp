@@ -9,9 +9,10 @@
 #include <string>
 
 #include "ip_part.hpp"
+#include "shapes.hpp"
 
 
-unsigned int setupVAO(float* vertices, int v_size, unsigned int* indices, int i_size, float* colours, int c_size);
+VAO_t setupVAO(float* vertices, int v_size, unsigned int* indices, int i_size, float* colours, int c_size);
 
 // Main OpenGL program
 void runProgram(GLFWwindow* window, Board board);
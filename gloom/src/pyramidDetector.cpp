@@ -0,0 +1,112 @@
+#include <algorithm>
+
+#include "pyramidDetector.hpp"
+
+using namespace cv;
+
+// Coarse voting may be looser, every candidate is checked at full resolution
+const double coarseVotesFactor = 0.8;
+// Refinement window side relative to the template size
+const double refineWindowFactor = 1.5;
+
+
+/* Edge template resized by factor, kept binary */
+Mat scaleEdges(const Mat& edges, double factor) {
+	if (factor == 1.0) return edges;
+	Mat scaled;
+	resize(edges, scaled, Size(), factor, factor, factor < 1.0 ? INTER_AREA : INTER_LINEAR);
+	threshold(scaled, scaled, 64, 255, THRESH_BINARY);
+	return scaled;
+}
+
+
+PyramidDetector::PyramidDetector(const TemplateBank& bank, const std::vector<double>& scales, double coarseFactor)
+	: coarseFactor(coarseFactor) {
+	for (int i = 0; i < bank.size(); i++) {
+		std::vector<Level> templateLevels;
+		for (int j = 0; j < scales.size(); j++) {
+			double scale = scales[j];
+			Mat fineEdges = scaleEdges(bank.templateEdges(i), scale);
+			Mat coarseEdges = scaleEdges(bank.templateEdges(i), scale * coarseFactor);
+
+			// Votes grow with the edge length, so scale the thresholds with the template
+			Level level;
+			level.scale = scale;
+			level.templateSize = fineEdges.size();
+			level.edgePoints = countNonZero(fineEdges);
+			level.coarse = createTemplateDetector(coarseEdges,
+				std::max(1, cvRound(templateVotesThreshold * scale * coarseFactor * coarseVotesFactor)),
+				templateMinDist * coarseFactor,
+				std::max(1.0, templateDp * coarseFactor));
+			level.fine = createTemplateDetector(fineEdges,
+				std::max(1, cvRound(templateVotesThreshold * scale)),
+				templateMinDist,
+				std::max(1.0, templateDp / 2)); // Windows are small, afford a finer accumulator
+			templateLevels.push_back(level);
+		}
+		levels.push_back(templateLevels);
+	}
+}
+
+
+/* Detect all templates, concurrently if a pool is given */
+std::vector<std::vector<Vec4f>> PyramidDetector::detect(const Mat& image, const GradientMap& gradients, ThreadPool* pool) {
+	resize(image, coarseImage, Size(), coarseFactor, coarseFactor, INTER_AREA);
+	computeGradients(coarseImage, coarseGradients);
+
+	std::vector<std::vector<Vec4f>> positions(levels.size());
+	if (!pool) {
+		for (int i = 0; i < levels.size(); i++) {
+			positions[i] = detectTemplate(gradients, i);
+		}
+		return positions;
+	}
+
+	// Each task only uses the detectors of its own template
+	std::vector<std::future<void>> done;
+	for (int i = 0; i < levels.size(); i++) {
+		std::vector<Vec4f>* templPositions = &positions[i];
+		done.push_back(pool->submit([this, &gradients, templPositions, i]() {
+			*templPositions = detectTemplate(gradients, i);
+		}));
+	}
+	for (int i = 0; i < done.size(); i++) {
+		done[i].get();
+	}
+	return positions;
+}
+
+
+/* Coarse candidates for template i at every scale, refined in full resolution windows */
+std::vector<Vec4f> PyramidDetector::detectTemplate(const GradientMap& gradients, int i) {
+	std::vector<Vec4f> found;
+	Rect imageRect(0, 0, gradients.edges.cols, gradients.edges.rows);
+	for (int j = 0; j < levels[i].size(); j++) {
+		Level& level = levels[i][j];
+		std::vector<Vec4f> candidates;
+		level.coarse->detect(coarseGradients.edges, coarseGradients.dxf, coarseGradients.dyf, candidates);
+
+		int windowWidth = cvRound(level.templateSize.width * refineWindowFactor);
+		int windowHeight = cvRound(level.templateSize.height * refineWindowFactor);
+		for (int k = 0; k < candidates.size(); k++) {
+			Point center(cvRound(candidates[k][0] / coarseFactor), cvRound(candidates[k][1] / coarseFactor));
+			Rect window = Rect(center.x - windowWidth / 2, center.y - windowHeight / 2, windowWidth, windowHeight) & imageRect;
+			if (window.width < level.templateSize.width || window.height < level.templateSize.height) {
+				continue; // Piece would be cut by the image border
+			}
+
+			// Keep the refined position with the most votes
+			std::vector<Vec4f> refined;
+			GradientMap windowGradients = gradients(window);
+			detectWithVotes(level.fine, level.edgePoints, windowGradients.edges, windowGradients.dxf, windowGradients.dyf, refined);
+			int best = -1;
+			for (int m = 0; m < refined.size(); m++) {
+				if (best < 0 || refined[m][3] > refined[best][3]) best = m;
+			}
+			if (best >= 0) {
+				found.push_back(Vec4f(window.x + refined[best][0], window.y + refined[best][1], (float)level.scale, refined[best][3]));
+			}
+		}
+	}
+	return found;
+}
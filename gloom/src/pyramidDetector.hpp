@@ -0,0 +1,51 @@
+#ifndef PYRAMID_DETECTOR_HPP
+#define PYRAMID_DETECTOR_HPP
+
+#include <opencv2/opencv.hpp>
+#include <vector>
+
+#include "templateBank.hpp"
+#include "threadPool.hpp"
+#include "gradientMap.hpp"
+
+
+/*
+ * Coarse-to-fine Generalized Hough detection over several template scales.
+ * Candidate centers are voted for on a downscaled image, then each one is
+ * confirmed and placed by voting again at full resolution, but only in a small
+ * window around it. Handles pieces somewhat smaller or larger than the
+ * templates, at a fraction of the full frame accumulator work.
+ */
+class PyramidDetector {
+public:
+	// scales are template sizes relative to their native size, coarseFactor
+	// is the size of the coarse image relative to the input
+	explicit PyramidDetector(const TemplateBank& bank,
+	                         const std::vector<double>& scales = std::vector<double>{ 0.8, 1.0, 1.25 },
+	                         double coarseFactor = 0.5);
+
+	// Positions (x, y, scale, votes) per template in input coordinates, like
+	// detectTemplates(). gradients must be those of image, they serve the full
+	// resolution windows. Templates run concurrently if a pool is given.
+	std::vector<std::vector<cv::Vec4f>> detect(const cv::Mat& image, const GradientMap& gradients, ThreadPool* pool = nullptr);
+
+private:
+	// Detectors for one template at one scale
+	struct Level {
+		double scale;
+		cv::Size templateSize;                       // At full resolution
+		int edgePoints;                              // Of the full resolution template, for relative votes
+		cv::Ptr<cv::GeneralizedHoughBallard> coarse; // For the downscaled image
+		cv::Ptr<cv::GeneralizedHoughBallard> fine;   // For windows at full resolution
+	};
+
+	std::vector<cv::Vec4f> detectTemplate(const GradientMap& gradients, int i);
+
+	double coarseFactor;
+	std::vector<std::vector<Level>> levels; // [template][scale]
+	cv::Mat coarseImage;                    // Buffers reused between calls
+	GradientMap coarseGradients;
+};
+
+
+#endif // !PYRAMID_DETECTOR_HPP
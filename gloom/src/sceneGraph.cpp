@@ -1,3 +1,5 @@
+#include <glad/glad.h>
+
 #include "sceneGraph.hpp"
 
 // --- Matrix Stack related functions ---
@@ -53,6 +55,10 @@ SceneNode* createSceneNode() {
 	node->rotationDirection = glm::vec3(0, 1, 0);
 	node->vertexArrayObjectID = -1;
 	node->indexCount = 0;
+	node->indexType = GL_UNSIGNED_INT;
+	node->instancedMesh = -1;
+	node->colour = glm::vec4(1.0);
+	node->lod = nullptr;
 	node->pieceGridPos = glm::vec2(-1);
 	node->modelType = ModelType::GENERIC;
 	node->isAnimating = false;
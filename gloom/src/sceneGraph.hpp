@@ -25,6 +25,8 @@ glm::mat4 peekMatrix(std::stack<glm::mat4>* stack);
 
 void printMatrix(glm::mat4 matrix);
 
+struct LodChain;
+
 // For when model type info is needed
 enum class ModelType {
 	GENERIC,
@@ -66,6 +68,15 @@ typedef struct SceneNode {
 
 	// Number of indices in the VAO
 	unsigned int indexCount;
+	// GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+	unsigned int indexType;
+
+	// Index of the shared mesh this node is drawn instanced with, -1 to draw its own VAO
+	int instancedMesh;
+	// Instance colour, multiplied with the mesh colour
+	glm::vec4 colour;
+	// Detail levels to pick the VAO from each frame, nullptr to always draw vertexArrayObjectID
+	const LodChain* lod;
 
 	// Type for the model of this scene node
 	ModelType modelType;
@@ -0,0 +1,124 @@
+#include <algorithm>
+#include <cfloat>
+#include <stdexcept>
+#include <string>
+
+#include "shapeClassifier.hpp"
+
+using namespace cv;
+
+// Polygon approximation tolerance relative to the contour perimeter
+const double polygonEpsilon = 0.02;
+// Convexity defects deeper than this fraction of the contour size count
+const double deepDefectFraction = 0.1;
+// Contours must cover this fraction of the square to be a piece
+const double minPieceArea = 0.05;
+// Contours spanning more than this fraction of both square sides are the grid frame
+const double frameSpan = 0.95;
+
+
+/* Largest outer contour of a binary image. Squares skip anything that spans the
+   whole image, cropped templates have to keep their outline however close it gets. */
+bool largestContour(const Mat& binary, std::vector<Point>& largest, bool skipFrame = true) {
+	std::vector<std::vector<Point>> contours;
+	Mat work = binary.clone(); // findContours modifies its input in OpenCV 3
+	findContours(work, contours, RETR_EXTERNAL, CHAIN_APPROX_SIMPLE);
+
+	double largestArea = minPieceArea * binary.total();
+	bool found = false;
+	for (int i = 0; i < contours.size(); i++) {
+		Rect bounds = boundingRect(contours[i]);
+		if (skipFrame && bounds.width >= frameSpan * binary.cols && bounds.height >= frameSpan * binary.rows) continue;
+		double area = contourArea(contours[i]);
+		if (area >= largestArea) {
+			largestArea = area;
+			largest = contours[i];
+			found = true;
+		}
+	}
+	return found;
+}
+
+
+/* Corner count and deep convexity defects of a contour */
+bool ShapeClassifier::signatureOf(const std::vector<Point>& contour, Signature& signature) {
+	if (contour.size() < 3) return false;
+	signature.contour = contour;
+
+	std::vector<Point> polygon;
+	approxPolyDP(contour, polygon, polygonEpsilon * arcLength(contour, true), true);
+	signature.corners = polygon.size();
+
+	// Defect depths are fixed point with 8 fractional bits
+	std::vector<int> hull;
+	std::vector<Vec4i> defects;
+	convexHull(contour, hull, false, false);
+	signature.deepDefects = 0;
+	if (hull.size() > 3) {
+		convexityDefects(contour, hull, defects);
+		Rect bounds = boundingRect(contour);
+		double minDepth = deepDefectFraction * std::max(bounds.width, bounds.height);
+		for (int i = 0; i < defects.size(); i++) {
+			if (defects[i][3] / 256.0 >= minDepth) signature.deepDefects++;
+		}
+	}
+	return true;
+}
+
+
+/* Outline signatures of the templates, closed so small gaps in the edges do not split them */
+ShapeClassifier::ShapeClassifier(const TemplateBank& bank) {
+	Mat kernel = getStructuringElement(MORPH_RECT, Size(3, 3));
+	for (int i = 0; i < bank.size(); i++) {
+		Mat closed;
+		morphologyEx(bank.templateEdges(i), closed, MORPH_CLOSE, kernel);
+		std::vector<Point> contour;
+		Signature signature;
+		if (!largestContour(closed, contour, false) || !signatureOf(contour, signature)) {
+			throw std::runtime_error("No outline found in template " + std::to_string(i));
+		}
+		references.push_back(signature);
+	}
+}
+
+
+/* Nearest template outline by Hu moments, more confident when the corners and defects agree */
+PieceShape ShapeClassifier::classify(const Mat& square, double* confidence) const {
+	*confidence = 0;
+	Mat binary;
+	threshold(square, binary, 0, 255, THRESH_BINARY | THRESH_OTSU);
+
+	// The piece is whatever differs from the square's border
+	int borderSum = sum(binary.row(0))[0] + sum(binary.row(binary.rows - 1))[0]
+		+ sum(binary.col(0))[0] + sum(binary.col(binary.cols - 1))[0];
+	if (borderSum > 255 * (binary.rows + binary.cols)) {
+		bitwise_not(binary, binary);
+	}
+
+	std::vector<Point> contour;
+	Signature signature;
+	if (!largestContour(binary, contour) || !signatureOf(contour, signature)) {
+		return PieceShape::NONE;
+	}
+
+	int best = 0;
+	double bestDistance = DBL_MAX, secondDistance = DBL_MAX;
+	for (int i = 0; i < references.size(); i++) {
+		double distance = matchShapes(contour, references[i].contour, CV_CONTOURS_MATCH_I2, 0);
+		if (distance < bestDistance) {
+			secondDistance = bestDistance;
+			bestDistance = distance;
+			best = i;
+		} else if (distance < secondDistance) {
+			secondDistance = distance;
+		}
+	}
+
+	// Margin to the runner-up, plus a bonus when the outline structure matches too.
+	// A tie gets no bonus, so an ambiguous outline always goes to the fallback.
+	double margin = secondDistance > 0 ? 1 - bestDistance / secondDistance : 0;
+	const Signature& reference = references[best];
+	bool structureMatches = signature.corners == reference.corners && signature.deepDefects == reference.deepDefects;
+	*confidence = std::min(1.0, margin + (margin > 0 && structureMatches ? 0.5 : 0.0));
+	return static_cast<PieceShape>(best + 1);
+}
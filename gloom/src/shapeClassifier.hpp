@@ -0,0 +1,43 @@
+#ifndef SHAPE_CLASSIFIER_HPP
+#define SHAPE_CLASSIFIER_HPP
+
+#include <opencv2/opencv.hpp>
+#include <vector>
+
+#include "ip_part.hpp"
+#include "templateBank.hpp"
+
+
+// Below this confidence the caller should ask the Hough detectors instead
+const double shapeMinConfidence = 0.5;
+
+/*
+ * Fast classification of one square from the outline of the piece in it.
+ * The square is thresholded (Otsu), the largest outer contour that is not the
+ * grid frame is compared with each template's outline through Hu moments
+ * (matchShapes), and the polygon corner count and deep convexity defects are
+ * checked against the template's. Costs microseconds instead of a Hough vote.
+ */
+class ShapeClassifier {
+public:
+	explicit ShapeClassifier(const TemplateBank& bank);
+
+	// Shape in a gray square image with a confidence from 0 to 1. NONE with
+	// confidence 0 if no piece-like contour was found.
+	PieceShape classify(const cv::Mat& square, double* confidence) const;
+
+private:
+	// Outline measures compared between squares and templates
+	struct Signature {
+		std::vector<cv::Point> contour;
+		int corners;        // Vertices of the polygon approximation
+		int deepDefects;    // Convexity defects deeper than a tenth of the size
+	};
+
+	static bool signatureOf(const std::vector<cv::Point>& contour, Signature& signature);
+
+	std::vector<Signature> references; // Per template, in PieceShape order
+};
+
+
+#endif // !SHAPE_CLASSIFIER_HPP
@@ -77,10 +77,10 @@ VAO_t createHex(colour_t colour) {
 		5, 0, 6
 	};
 
-	unsigned int vaoID = setupVAO(vertices, vertexSize, indices, indexCount, colours, colourSize);
+	VAO_t model = setupVAO(vertices, vertexSize, indices, indexCount, colours, colourSize);
 	delete vertices;
 	delete colours;
-	return VAO_t{ vaoID, indexCount };
+	return model;
 }
 
 
@@ -171,10 +171,10 @@ VAO_t createStar(colour_t colour) {
 		9, 0, 10
 	};
 
-	unsigned int vaoID = setupVAO(vertices, vertexSize, indices, indexCount, colours, colourSize);
+	VAO_t model = setupVAO(vertices, vertexSize, indices, indexCount, colours, colourSize);
 	delete vertices;
 	delete colours;
-	return VAO_t{ vaoID, indexCount };
+	return model;
 }
 
 
@@ -316,10 +316,10 @@ VAO_t create34thCircle(colour_t colour) {
 		16, 0, 17
 	};
 
-	unsigned int vaoID = setupVAO(vertices, vertexSize, indices, indexCount, colours, colourSize);
+	VAO_t model = setupVAO(vertices, vertexSize, indices, indexCount, colours, colourSize);
 	delete vertices;
 	delete colours;
-	return VAO_t{ vaoID, indexCount };
+	return model;
 }
 
 
@@ -390,8 +390,8 @@ VAO_t createA(colour_t colour) {
 		5, 6, 11, // Side 6
 		5, 0, 6
 	};
-	unsigned int vaoID = setupVAO(vertices, vertexSize, indices, indexCount, colours, colourSize);
-	return VAO_t{ vaoID, indexCount };
+	VAO_t model = setupVAO(vertices, vertexSize, indices, indexCount, colours, colourSize);
+	return model;
 }
 
 
@@ -434,8 +434,8 @@ VAO_t createTriangle(colour_t colour) {
 		2, 3, 5, // Side 3
 		2, 0, 3
 	};
-	unsigned int vaoID = setupVAO(vertices, vertexSize, indices, indexCount, colours, colourSize);
-	return VAO_t{ vaoID, indexCount };
+	VAO_t model = setupVAO(vertices, vertexSize, indices, indexCount, colours, colourSize);
+	return model;
 }
 
 
@@ -483,8 +483,8 @@ VAO_t createPoGram(colour_t colour) {
 		3, 4, 7, // Side 4
 		3, 0, 4,
 	};
-	unsigned int vaoID = setupVAO(vertices, vertexSize, indices, indexCount, colours, colourSize);
-	return VAO_t{ vaoID, indexCount };
+	VAO_t model = setupVAO(vertices, vertexSize, indices, indexCount, colours, colourSize);
+	return model;
 }
 
 
@@ -529,6 +529,6 @@ VAO_t createSlab(colour_t colour) {
 		3, 4, 7, // Side 4
 		3, 0, 4,
 	};
-	unsigned int vaoID = setupVAO(vertices, vertexSize, indices, indexCount, colours, colourSize);
-	return VAO_t{ vaoID, indexCount };
+	VAO_t model = setupVAO(vertices, vertexSize, indices, indexCount, colours, colourSize);
+	return model;
 }
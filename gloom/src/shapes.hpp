@@ -13,16 +13,27 @@ typedef struct colour_t {
 typedef struct VAO_t {
 	unsigned int vaoID;
 	int indexCount;
+	unsigned int indexType; // GL_UNSIGNED_SHORT when all indices fit, else GL_UNSIGNED_INT
 };
 
 
-VAO_t createHex(colour_t colour = colour_t{ 0.9f, 0.9f, 0.9f, 1.0f, 0.0f });
-VAO_t createStar(colour_t colour = colour_t{ 0.1f, 0.1f, 0.9f, 1.0f, 0.0f });
-VAO_t create34thCircle(colour_t colour = colour_t{ 0.9f, 0.0f, 0.0f, 1.0f, 0.0f });
-VAO_t createA(colour_t colour = colour_t{ 0.8f, 0.9f, 0.0f, 1.0f, 0.0f });
-VAO_t createTriangle(colour_t colour = colour_t{ 0.8f, 0.0f, 0.9f, 1.0f, 0.0f });
-VAO_t createPoGram(colour_t colour = colour_t{ 0.0f, 0.9f, 0.0f, 1.0f, 0.0f });
-VAO_t createSlab(colour_t colour = colour_t{ 1.0f, 0.0f, 0.0f, 1.0f, 0.0f });
+// Default colours, the cached meshes are white and get these per instance
+const colour_t white = { 1.0f, 1.0f, 1.0f, 1.0f, 0.0f };
+const colour_t hexColour = { 0.9f, 0.9f, 0.9f, 1.0f, 0.0f };
+const colour_t starColour = { 0.1f, 0.1f, 0.9f, 1.0f, 0.0f };
+const colour_t circleColour = { 0.9f, 0.0f, 0.0f, 1.0f, 0.0f };
+const colour_t aColour = { 0.8f, 0.9f, 0.0f, 1.0f, 0.0f };
+const colour_t triangleColour = { 0.8f, 0.0f, 0.9f, 1.0f, 0.0f };
+const colour_t poGramColour = { 0.0f, 0.9f, 0.0f, 1.0f, 0.0f };
+const colour_t slabColour = { 1.0f, 0.0f, 0.0f, 1.0f, 0.0f };
 
 
+VAO_t createHex(colour_t colour = hexColour);
+VAO_t createStar(colour_t colour = starColour);
+VAO_t create34thCircle(colour_t colour = circleColour);
+VAO_t createA(colour_t colour = aColour);
+VAO_t createTriangle(colour_t colour = triangleColour);
+VAO_t createPoGram(colour_t colour = poGramColour);
+VAO_t createSlab(colour_t colour = slabColour);
+
 #endif
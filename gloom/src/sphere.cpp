@@ -1,169 +1,108 @@
 
+#include <vector>
+
 #include "sphere.hpp"
 #include "program.hpp"
 #include "sceneGraph.hpp"
 
 
 // Creates a VAO containing a sphere with a resolution specified by slices and layers, with a radius of 1.
+// Neighbouring quads share their corner vertices through the index buffer.
 
-unsigned int createCircleVAO(unsigned int slices, unsigned int layers, float red, float green, float blue, float colorFlux) {
-	
-	// Calculating how large our buffers have to be
-	// The sphere is defined as layers containing rectangles. Each rectangle requires us to draw two triangles
-	const unsigned int PRIMITIVES_PER_RECTANGLE = 2;
-	const unsigned int triangleCount = slices * layers * PRIMITIVES_PER_RECTANGLE;
+VAO_t createCircleVAO(unsigned int slices, unsigned int layers, float red, float green, float blue, float colorFlux) {
 
-	// Allocating buffers
+	// One ring of vertices per layer boundary, the last slice wraps around to the first
+	const unsigned int ringCount = layers + 1;
+	const unsigned int vertexCount = ringCount * slices;
+
+	// Each rectangle is two triangles, except at the poles where one of them has no area
 	const unsigned int VERTICES_PER_TRIANGLE = 3;
+	const unsigned int triangleCount = layers > 1 ? slices * (2 * layers - 2) : 0;
+
+	// Allocating buffers
 	const unsigned int COMPONENTS_PER_VERTEX = 3;
-	float* vertices = new float[triangleCount * VERTICES_PER_TRIANGLE * COMPONENTS_PER_VERTEX];
-	float* colours = new float[triangleCount * VERTICES_PER_TRIANGLE * 4];
+	float* vertices = new float[vertexCount * COMPONENTS_PER_VERTEX];
+	float* colours = new float[vertexCount * 4];
 	unsigned int* indices = new unsigned int[triangleCount * VERTICES_PER_TRIANGLE];
 
 	// Randomly vary colors in range +/- colorFlux
 	float newColors[3][3];
-	newColors[0][0] = red + (2 * colorFlux * random() - colorFlux);
-	newColors[0][1] = green + (2 * colorFlux * random() - colorFlux);
-	newColors[0][2] = blue + (2 * colorFlux * random() - colorFlux);
-
-	newColors[1][0] = red + (2 * colorFlux * random() - colorFlux);
-	newColors[1][1] = green + (2 * colorFlux * random() - colorFlux);
-	newColors[1][2] = blue + (2 * colorFlux * random() - colorFlux);
-
-	newColors[2][0] = red + (2 * colorFlux * random() - colorFlux);
-	newColors[2][1] = green + (2 * colorFlux * random() - colorFlux);
-	newColors[2][2] = blue + (2 * colorFlux * random() - colorFlux);
+	for (int c = 0; c < 3; c++) {
+		newColors[c][0] = red + (2 * colorFlux * random() - colorFlux);
+		newColors[c][1] = green + (2 * colorFlux * random() - colorFlux);
+		newColors[c][2] = blue + (2 * colorFlux * random() - colorFlux);
+	}
 
-	// Slices require us to define a full revolution worth of triangles.
+	// Slices require us to define a full revolution worth of vertices.
 	// Layers only requires angle varying between the bottom and the top (a layer only covers half a circle worth of angles)
 	const float degreesPerLayer = 180.0 / (float) layers;
 	const float degreesPerSlice = 360.0 / (float) slices;
 
-	// Keeping track of the triangle index in the buffer. 
-	// This implementation is fairly naive in the sense that it does not reuse vertices with the index buffer.
-	int i = 0;
-
-	// Constructing the sphere one layer at a time
-	for (int layer = 0; layer < layers; layer++) {
-		int nextLayer = layer + 1;
-
-		// Angles between the vector pointing to any point on a particular layer and the negative z-axis
-		float currentAngleZDegrees = degreesPerLayer * layer;
-		float nextAngleZDegrees = degreesPerLayer * nextLayer;
+	// The direction of every slice in the xy-plane is the same for all rings
+	std::vector<float> sliceDirectionX(slices);
+	std::vector<float> sliceDirectionY(slices);
+	for (int slice = 0; slice < slices; slice++) {
+		sliceDirectionX[slice] = cos(toRadians(slice * degreesPerSlice));
+		sliceDirectionY[slice] = sin(toRadians(slice * degreesPerSlice));
+	}
 
-		// All coordinates within a single layer share z-coordinates. 
-		// So we can calculate those of the current and subsequent layer here.
-		float currentZ = -cos(toRadians(currentAngleZDegrees));
-		float nextZ = -cos(toRadians(nextAngleZDegrees));
+	// Constructing the vertices one ring at a time
+	for (int ring = 0; ring < ringCount; ring++) {
+		// Angle between the vector pointing to any point on the ring and the negative z-axis
+		float angleZDegrees = degreesPerLayer * ring;
 
-		// The row of vertices forms a circle around the vertical diagonal (z-axis) of the sphere.
-		// These radii are also constant for an entire layer, so we can precalculate them.
-		float radius = sin(toRadians(currentAngleZDegrees));
-		float nextRadius = sin(toRadians(nextAngleZDegrees));
+		// All vertices on a ring share their z-coordinate and their distance to the z-axis
+		float z = -cos(toRadians(angleZDegrees));
+		float radius = sin(toRadians(angleZDegrees));
 
-		// Now we can move on to constructing individual slices within a layer
 		for (int slice = 0; slice < slices; slice++) {
-			
-			// The direction of the start and the end of the slice in the xy-plane
-			float currentSliceAngleDegrees = slice * degreesPerSlice;
-			float nextSliceAngleDegrees = (slice + 1) * degreesPerSlice;
-
-			// Determining the direction vector for both the start and end of the slice
-			float currentDirectionX = cos(toRadians(currentSliceAngleDegrees));
-			float currentDirectionY = sin(toRadians(currentSliceAngleDegrees));
-
-			float nextDirectionX = cos(toRadians(nextSliceAngleDegrees));
-			float nextDirectionY = sin(toRadians(nextSliceAngleDegrees));
-
-			// Now we have all information needed to create triangles
-
-			// Triangle 1
-			
-			vertices[3 * i + 0] = radius * currentDirectionX;
-			vertices[3 * i + 1] = radius * currentDirectionY;
-			vertices[3 * i + 2] = currentZ;
-
-			colours[4*i+0] = newColors[0][0];
-			colours[4*i+1] = newColors[0][1];
-			colours[4*i+2] = newColors[0][2];
-			colours[4*i+3] = 1.0;
-
-			indices[i] = i;
-			i++;
-
-			vertices[3 * i + 0] = radius * nextDirectionX;
-			vertices[3 * i + 1] = radius * nextDirectionY;
-			vertices[3 * i + 2] = currentZ;
-
-			colours[4*i+0] = newColors[1][0];
-			colours[4*i+1] = newColors[1][1];
-			colours[4*i+2] = newColors[1][2];
-			colours[4*i+3] = 1.0;
-
-			indices[i] = i;
-			i++;
-
-			vertices[3 * i + 0] = nextRadius * nextDirectionX;
-			vertices[3 * i + 1] = nextRadius * nextDirectionY;
-			vertices[3 * i + 2] = nextZ;
-
-			colours[4*i+0] = newColors[2][0];
-			colours[4*i+1] = newColors[2][1];
-			colours[4*i+2] = newColors[2][2];
-			colours[4*i+3] = 1.0;
-
-			indices[i] = i;
-			i++;
-
-			// Triangle 2
-
-			vertices[3 * i + 0] = radius * currentDirectionX;
-			vertices[3 * i + 1] = radius * currentDirectionY;
-			vertices[3 * i + 2] = currentZ;
-
-			colours[4*i+0] = newColors[0][0];
-			colours[4*i+1] = newColors[0][1];
-			colours[4*i+2] = newColors[0][2];
-			colours[4*i+3] = 1.0;
-
-			indices[i] = i;
-			i++;
-
-			vertices[3 * i + 0] = nextRadius * nextDirectionX;
-			vertices[3 * i + 1] = nextRadius * nextDirectionY;
-			vertices[3 * i + 2] = nextZ;
-
-			colours[4*i+0] = newColors[2][0];
-			colours[4*i+1] = newColors[2][1];
-			colours[4*i+2] = newColors[2][2];
-			colours[4*i+3] = 1.0;
-
-			indices[i] = i;
-			i++;
-
-			vertices[3 * i + 0] = nextRadius * currentDirectionX;
-			vertices[3 * i + 1] = nextRadius * currentDirectionY;
-			vertices[3 * i + 2] = nextZ;
-
-			colours[4*i+0] = newColors[1][0];
-			colours[4*i+1] = newColors[1][1];
-			colours[4*i+2] = newColors[1][2];
-			colours[4*i+3] = 1.0;
+			int v = ring * slices + slice;
+			vertices[3 * v + 0] = radius * sliceDirectionX[slice];
+			vertices[3 * v + 1] = radius * sliceDirectionY[slice];
+			vertices[3 * v + 2] = z;
+
+			// Neighbouring vertices get different colours so the variation shows
+			const float* colour = newColors[(ring + slice) % 3];
+			colours[4 * v + 0] = colour[0];
+			colours[4 * v + 1] = colour[1];
+			colours[4 * v + 2] = colour[2];
+			colours[4 * v + 3] = 1.0;
+		}
+	}
 
-			indices[i] = i;
-			i++;
+	// Two triangles per rectangle between ring and ring + 1
+	int i = 0;
+	for (int layer = 0; layer < layers; layer++) {
+		for (int slice = 0; slice < slices; slice++) {
+			unsigned int nextSlice = (slice + 1) % slices;
+			unsigned int current = layer * slices + slice;
+			unsigned int currentNext = layer * slices + nextSlice;
+			unsigned int upper = (layer + 1) * slices + slice;
+			unsigned int upperNext = (layer + 1) * slices + nextSlice;
+
+			// Triangle 1, without area on the first layer where the ring is a single point
+			if (layer > 0) {
+				indices[i++] = current;
+				indices[i++] = currentNext;
+				indices[i++] = upperNext;
+			}
+
+			// Triangle 2, without area on the last layer
+			if (layer < layers - 1) {
+				indices[i++] = current;
+				indices[i++] = upperNext;
+				indices[i++] = upper;
+			}
 		}
 	}
 
 	// Sending the created buffers over to OpenGL.
-	// Don't forget to modify this to fit the function you created yourself!
-	// You will have to include a file which contains the implementation of this function for this to work.
-	unsigned int vao_id = setupVAO(vertices,
-								   triangleCount*VERTICES_PER_TRIANGLE*COMPONENTS_PER_VERTEX,
-								   indices,
-								   triangleCount*VERTICES_PER_TRIANGLE,
-								   colours,
-								   triangleCount*VERTICES_PER_TRIANGLE*4
+	VAO_t sphere = setupVAO(vertices,
+							vertexCount*COMPONENTS_PER_VERTEX,
+							indices,
+							triangleCount*VERTICES_PER_TRIANGLE,
+							colours,
+							vertexCount*4
 	);
 
 	// Cleaning up after ourselves
@@ -171,5 +110,5 @@ unsigned int createCircleVAO(unsigned int slices, unsigned int layers, float red
 	delete[] colours;
 	delete[] indices;
 
-	return vao_id;
-}
\ No newline at end of file
+	return sphere;
+}
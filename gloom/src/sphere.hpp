@@ -2,6 +2,7 @@
 
 #include <math.h>
 #include "SceneGraph.hpp"
+#include "shapes.hpp"
 
 
-unsigned int createCircleVAO(unsigned int slices, unsigned int layers, float red, float green, float blue, float colorFlux);
+VAO_t createCircleVAO(unsigned int slices, unsigned int layers, float red, float green, float blue, float colorFlux);
@@ -0,0 +1,149 @@
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+#include "templateBank.hpp"
+#include "ip_process.hpp"
+
+using namespace cv;
+
+// Template files (order matters, see PieceShape)
+const std::string templateFiles[] = {
+	"34circle.png",
+	"a.png",
+	"hex.png",
+	"pogram.png",
+	"star.png",
+	"triangle.png"
+};
+
+// Cache file header, bump version when the stored data changes
+const char cacheMagic[4] = { 'C', 'P', 'T', 'B' };
+const int cacheVersion = 1;
+
+
+/* Load template images from directory and Canny them */
+void TemplateBank::loadImages(const std::string& directory) {
+	edges.clear();
+	for (int i = 0; i < sizeof(templateFiles) / sizeof(templateFiles[0]); i++) {
+		Mat templ = readImage(directory + templateFiles[i]);
+		cvtColor(templ, templ, CV_BGR2GRAY);
+		Canny(templ, templ, 50, 100, 3, true);
+		edges.push_back(templ);
+	}
+	createDetectors();
+}
+
+
+/* Write edge templates as: magic, version, count, then (rows, cols, data) per template */
+void TemplateBank::saveCache(const std::string& filename) const {
+	std::ofstream file(filename, std::ios::binary);
+	if (!file) {
+		throw std::runtime_error("Could not write template cache: " + filename);
+	}
+	int count = edges.size();
+	file.write(cacheMagic, sizeof(cacheMagic));
+	file.write((const char*)&cacheVersion, sizeof(cacheVersion));
+	file.write((const char*)&count, sizeof(count));
+	for (int i = 0; i < count; i++) {
+		Mat templ = edges[i].isContinuous() ? edges[i] : edges[i].clone();
+		file.write((const char*)&templ.rows, sizeof(templ.rows));
+		file.write((const char*)&templ.cols, sizeof(templ.cols));
+		file.write((const char*)templ.data, templ.total());
+	}
+}
+
+
+/* Read edge templates written by saveCache */
+bool TemplateBank::loadCache(const std::string& filename) {
+	std::ifstream file(filename, std::ios::binary);
+	if (!file) return false;
+
+	char magic[sizeof(cacheMagic)];
+	int version = 0, count = 0;
+	file.read(magic, sizeof(magic));
+	file.read((char*)&version, sizeof(version));
+	file.read((char*)&count, sizeof(count));
+	if (!file || !std::equal(magic, magic + sizeof(magic), cacheMagic) || version != cacheVersion
+		|| count != sizeof(templateFiles) / sizeof(templateFiles[0])) {
+		return false;
+	}
+
+	std::vector<Mat> cached;
+	for (int i = 0; i < count; i++) {
+		int rows = 0, cols = 0;
+		file.read((char*)&rows, sizeof(rows));
+		file.read((char*)&cols, sizeof(cols));
+		if (!file || rows <= 0 || cols <= 0 || rows > 4096 || cols > 4096) return false;
+		Mat templ(rows, cols, CV_8UC1);
+		file.read((char*)templ.data, templ.total());
+		if (!file) return false;
+		cached.push_back(templ);
+	}
+	edges = cached;
+	createDetectors();
+	return true;
+}
+
+
+/* Load from cache file if possible, else from images and write the cache */
+TemplateBank TemplateBank::load(const std::string& directory, const std::string& cacheFile) {
+	TemplateBank bank;
+	if (cacheFile.empty() || !bank.loadCache(cacheFile)) {
+		bank.loadImages(directory);
+		if (!cacheFile.empty()) {
+			try {
+				bank.saveCache(cacheFile);
+			}
+			catch (std::runtime_error e) { // Not fatal, we just load images next time too
+				std::cerr << e.what() << std::endl;
+			}
+		}
+	}
+	return bank;
+}
+
+
+/* Copy with its own detectors, the Hough detectors are not thread safe */
+TemplateBank TemplateBank::clone() const {
+	TemplateBank copy;
+	copy.edges = edges;
+	copy.createDetectors();
+	return copy;
+}
+
+
+/* Set up one Generalized Hough detector per edge template */
+void TemplateBank::createDetectors() {
+	detectors.clear();
+	edgePointCounts.clear();
+	for (int i = 0; i < edges.size(); i++) {
+		detectors.push_back(createTemplateDetector(edges[i]));
+		edgePointCounts.push_back(countNonZero(edges[i]));
+	}
+}
+
+
+/* Generalized Hough detector for one edge template */
+Ptr<GeneralizedHoughBallard> createTemplateDetector(const Mat& edges, int votesThreshold, double minDist, double dp) {
+	Ptr<GeneralizedHoughBallard> ghb = createGeneralizedHoughBallard();
+	ghb->setTemplate(edges);
+	ghb->setCannyLowThresh(30);
+	ghb->setCannyHighThresh(80);
+	ghb->setMinDist(minDist);
+	ghb->setVotesThreshold(votesThreshold);
+	ghb->setDp(dp);
+	return ghb;
+}
+
+
+/* Template matches with their share of the template's edge points voting */
+void detectWithVotes(const Ptr<GeneralizedHoughBallard>& detector, int edgePoints,
+	const Mat& edges, const Mat& dx, const Mat& dy, std::vector<Vec4f>& positions) {
+	std::vector<Vec3i> votes;
+	detector->detect(edges, dx, dy, positions, votes);
+	for (int j = 0; j < positions.size() && j < votes.size(); j++) {
+		positions[j][3] = (float)votes[j][0] / std::max(1, edgePoints); // Ballard leaves the angle at 0
+	}
+}
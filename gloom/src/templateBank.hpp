@@ -0,0 +1,64 @@
+#ifndef TEMPLATE_BANK_HPP
+#define TEMPLATE_BANK_HPP
+
+#include <opencv2/opencv.hpp>
+#include <string>
+#include <vector>
+
+
+// Default locations, relative to the build directory like the other resources
+const std::string templateDirectory = "../images/templates/";
+const std::string templateCacheFile = "templates.cache";
+
+// Detector settings for templates at their native scale
+const int templateVotesThreshold = 75;
+const double templateMinDist = 20;
+const double templateDp = 4.0;
+
+// Generalized Hough detector for one edge template
+cv::Ptr<cv::GeneralizedHoughBallard> createTemplateDetector(const cv::Mat& edges,
+	int votesThreshold = templateVotesThreshold, double minDist = templateMinDist, double dp = templateDp);
+
+// Run a template detector, positions are (x, y, scale, votes) with the votes
+// relative to the template's edge point count, so that matches of templates
+// with different outline lengths can be compared
+void detectWithVotes(const cv::Ptr<cv::GeneralizedHoughBallard>& detector, int edgePoints,
+	const cv::Mat& edges, const cv::Mat& dx, const cv::Mat& dy, std::vector<cv::Vec4f>& positions);
+
+/*
+ * Piece templates that are loaded and edge-processed once, together with a
+ * configured Generalized Hough detector per template. Templates are kept in
+ * PieceShape order (index i is PieceShape i + 1), which is also detection priority.
+ */
+class TemplateBank {
+public:
+	// Load template images from directory and Canny them
+	void loadImages(const std::string& directory);
+
+	// Store or restore the edge-processed templates in a binary cache file.
+	// loadCache returns false if the file is missing or not a valid cache.
+	void saveCache(const std::string& filename) const;
+	bool loadCache(const std::string& filename);
+
+	// Load from cache file if possible, else from images and write the cache
+	static TemplateBank load(const std::string& directory = templateDirectory,
+	                         const std::string& cacheFile = templateCacheFile);
+
+	// Copy with its own detectors, for use on another thread
+	TemplateBank clone() const;
+
+	int size() const { return edges.size(); }
+	const cv::Mat& templateEdges(int i) const { return edges[i]; }
+	cv::Ptr<cv::GeneralizedHoughBallard> detector(int i) const { return detectors[i]; }
+	int edgePoints(int i) const { return edgePointCounts[i]; }
+
+private:
+	void createDetectors();
+
+	std::vector<cv::Mat> edges;
+	std::vector<cv::Ptr<cv::GeneralizedHoughBallard>> detectors;
+	std::vector<int> edgePointCounts;
+};
+
+
+#endif // !TEMPLATE_BANK_HPP
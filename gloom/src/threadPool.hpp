@@ -0,0 +1,152 @@
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+
+// Work split into numbered parts, for ThreadPool::parallelFor
+class ParallelTask {
+public:
+	virtual ~ParallelTask() {}
+	virtual void run(int part) = 0;
+};
+
+
+/*
+ * Fixed size pool of worker threads. Tasks are run in submission order and
+ * their results (or exceptions) are returned through futures. parallelFor
+ * runs the parts of one task through a slot in the pool instead, which
+ * allocates nothing and so suits work done on every frame.
+ */
+class ThreadPool {
+public:
+	// Uses one thread per hardware thread by default
+	explicit ThreadPool(int threadCount = 0)
+		: stopping(false), batch(nullptr), batchCount(0), batchNext(0), batchDone(0) {
+		if (threadCount <= 0) threadCount = std::thread::hardware_concurrency();
+		if (threadCount <= 0) threadCount = 1;
+		for (int i = 0; i < threadCount; i++) {
+			workers.push_back(std::thread(&ThreadPool::workerLoop, this));
+		}
+	}
+
+	// Finishes queued tasks before joining
+	~ThreadPool() {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		condition.notify_all();
+		for (int i = 0; i < workers.size(); i++) {
+			workers[i].join();
+		}
+	}
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	int size() const { return workers.size(); }
+
+	// Queue a task taking no arguments
+	template<class F>
+	std::future<typename std::result_of<F()>::type> submit(F task) {
+		typedef typename std::result_of<F()>::type Result;
+		// packaged_task is move only, std::function needs something copyable
+		std::shared_ptr<std::packaged_task<Result()>> packaged =
+			std::make_shared<std::packaged_task<Result()>>(task);
+		std::future<Result> result = packaged->get_future();
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			tasks.push([packaged]() { (*packaged)(); });
+		}
+		condition.notify_one();
+		return result;
+	}
+
+	// Run parts 0 to partCount - 1 of task on the workers and this thread, and
+	// return when all are done. The first exception of a part is rethrown.
+	// One task runs at a time, and parts must not call parallelFor themselves.
+	void parallelFor(ParallelTask& task, int partCount) {
+		std::unique_lock<std::mutex> lock(mutex);
+		batchFinished.wait(lock, [this]() { return batch == nullptr; });
+		batch = &task;
+		batchCount = partCount;
+		batchNext = 0;
+		batchDone = 0;
+		batchError = nullptr;
+		condition.notify_all();
+
+		// Take parts here too, so the task finishes even if every worker is busy
+		while (batchNext < batchCount) {
+			int part = batchNext++;
+			lock.unlock();
+			runPart(part);
+			lock.lock();
+		}
+		batchFinished.wait(lock, [this]() { return batchDone == batchCount; });
+		std::exception_ptr error = batchError;
+		batch = nullptr;
+		batchError = nullptr;
+		batchFinished.notify_all(); // The next task may start
+		lock.unlock();
+		if (error) std::rethrow_exception(error);
+	}
+
+private:
+	// Called without the lock held
+	void runPart(int part) {
+		std::exception_ptr error;
+		try {
+			batch->run(part);
+		}
+		catch (...) {
+			error = std::current_exception();
+		}
+		std::lock_guard<std::mutex> lock(mutex);
+		if (error && !batchError) batchError = error;
+		if (++batchDone == batchCount) batchFinished.notify_all();
+	}
+
+	void workerLoop() {
+		while (true) {
+			std::function<void()> task;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				condition.wait(lock, [this]() { return stopping || !tasks.empty() || (batch && batchNext < batchCount); });
+				if (batch && batchNext < batchCount) { // Parts of the running parallelFor come first
+					int part = batchNext++;
+					lock.unlock();
+					runPart(part);
+					continue;
+				}
+				if (tasks.empty()) return; // Stopping and nothing left to do
+				task = std::move(tasks.front());
+				tasks.pop();
+			}
+			task();
+		}
+	}
+
+	std::vector<std::thread> workers;
+	std::queue<std::function<void()>> tasks;
+	std::mutex mutex;
+	std::condition_variable condition;
+	bool stopping;
+
+	// The running parallelFor, guarded by mutex
+	ParallelTask* batch;
+	int batchCount, batchNext, batchDone;
+	std::exception_ptr batchError;
+	std::condition_variable batchFinished;
+};
+
+
+#endif // !THREAD_POOL_HPP